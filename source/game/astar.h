@@ -0,0 +1,312 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __ASTAR__
+#define __ASTAR__
+
+#include <algorithm>
+#include <cstdint>
+#include <game/id.h>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+
+class astar_node
+{
+  private:
+    size_t _key;
+    uint32_t _parent;
+    uint32_t _g;
+    uint32_t _h;
+    bool _closed;
+
+  public:
+    astar_node(const size_t key, const uint32_t parent, const uint32_t g, const uint32_t h)
+        : _key(key), _parent(parent), _g(g), _h(h), _closed(false) {}
+
+    inline void close()
+    {
+        _closed = true;
+    }
+    inline uint32_t f() const
+    {
+        return _g + _h;
+    }
+    inline uint32_t g() const
+    {
+        return _g;
+    }
+    inline uint32_t h() const
+    {
+        return _h;
+    }
+    inline bool is_closed() const
+    {
+        return _closed;
+    }
+    inline size_t key() const
+    {
+        return _key;
+    }
+    inline uint32_t parent() const
+    {
+        return _parent;
+    }
+    inline void relax(const uint32_t parent, const uint32_t g)
+    {
+        _parent = parent;
+        _g = g;
+        _closed = false;
+    }
+};
+
+class astar
+{
+  private:
+    typedef std::pair<uint32_t, uint32_t> heap_entry;
+    static constexpr uint32_t _no_parent = std::numeric_limits<uint32_t>::max();
+    const size_t _grid_scale;
+    const size_t _budget;
+    std::vector<uint32_t> _visit;
+    uint32_t _base;
+    std::vector<astar_node> _nodes;
+    std::vector<heap_entry> _heap;
+
+    static inline bool heap_compare(const heap_entry &a, const heap_entry &b)
+    {
+        // Min heap on f, break ties toward the deepest node
+        return (a.first > b.first) || (a.first == b.first && a.second < b.second);
+    }
+    static inline uint32_t distance(const size_t a, const size_t b)
+    {
+        return (a > b) ? a - b : b - a;
+    }
+    inline uint32_t heuristic(const size_t key, const size_t stop_key) const
+    {
+        // Manhattan distance is admissible on a six connected grid
+        const size_t scale2 = _grid_scale * _grid_scale;
+        const uint32_t dx = distance(key / scale2, stop_key / scale2);
+        const uint32_t dy = distance((key / _grid_scale) % _grid_scale, (stop_key / _grid_scale) % _grid_scale);
+        const uint32_t dz = distance(key % _grid_scale, stop_key % _grid_scale);
+
+        return dx + dy + dz;
+    }
+    inline void next_generation()
+    {
+        // Advance the generation past all nodes stamped this search
+        const uint32_t used = static_cast<uint32_t>(_nodes.size());
+        if (_base > std::numeric_limits<uint32_t>::max() - used - _budget)
+        {
+            // Only pay for a full clear when the stamps wrap around
+            reset();
+        }
+        else
+        {
+            _base += used;
+        }
+    }
+    inline void push(const size_t key, const uint32_t parent, const uint32_t g, const size_t stop_key)
+    {
+        // Stamp the cell with the arena index of this node
+        const uint32_t index = static_cast<uint32_t>(_nodes.size());
+        _visit[key] = _base + index;
+
+        // Allocate the node from the arena and push on the open heap
+        _nodes.emplace_back(key, parent, g, heuristic(key, stop_key));
+        _heap.emplace_back(_nodes.back().f(), index);
+        std::push_heap(_heap.begin(), _heap.end(), heap_compare);
+    }
+    template <typename F>
+    inline void relax(const size_t key, const uint32_t parent, const uint32_t g, const size_t stop_key, const F &is_open)
+    {
+        // Was this cell stamped during this search?
+        const uint32_t stamp = _visit[key];
+        if (stamp >= _base)
+        {
+            // Reopen the node if we found a cheaper route
+            const uint32_t index = stamp - _base;
+            astar_node &node = _nodes[index];
+            if (g < node.g())
+            {
+                node.relax(parent, g);
+                _heap.emplace_back(node.f(), index);
+                std::push_heap(_heap.begin(), _heap.end(), heap_compare);
+            }
+        }
+        else if (_nodes.size() < _budget && is_open(key))
+        {
+            push(key, parent, g, stop_key);
+        }
+    }
+    template <typename F>
+    inline void expand(const uint32_t index, const size_t stop_key, const F &is_open)
+    {
+        // Unpack key to components
+        const size_t key = _nodes[index].key();
+        const uint32_t g = _nodes[index].g() + 1;
+        const size_t scale2 = _grid_scale * _grid_scale;
+        const size_t x = key / scale2;
+        const size_t y = (key / _grid_scale) % _grid_scale;
+        const size_t z = key % _grid_scale;
+        const size_t edge = _grid_scale - 1;
+
+        // Check against x grid dimensions
+        if (x != 0)
+        {
+            relax(key - scale2, index, g, stop_key, is_open);
+        }
+        if (x != edge)
+        {
+            relax(key + scale2, index, g, stop_key, is_open);
+        }
+
+        // Check against y grid dimensions
+        if (y != 0)
+        {
+            relax(key - _grid_scale, index, g, stop_key, is_open);
+        }
+        if (y != edge)
+        {
+            relax(key + _grid_scale, index, g, stop_key, is_open);
+        }
+
+        // Check against z grid dimensions
+        if (z != 0)
+        {
+            relax(key - 1, index, g, stop_key, is_open);
+        }
+        if (z != edge)
+        {
+            relax(key + 1, index, g, stop_key, is_open);
+        }
+    }
+    inline void trace(std::vector<size_t> &path, uint32_t index, const size_t limit) const
+    {
+        // Walk the parent links back to the start node
+        while (index != _no_parent)
+        {
+            path.push_back(_nodes[index].key());
+            index = _nodes[index].parent();
+        }
+
+        // Path runs from start to stop
+        std::reverse(path.begin(), path.end());
+
+        // Only keep the first leg of a long path
+        if (path.size() > limit)
+        {
+            path.resize(limit);
+        }
+    }
+
+  public:
+    astar(const size_t grid_scale, const size_t budget)
+        : _grid_scale(grid_scale), _budget(budget),
+          _visit(grid_scale * grid_scale * grid_scale, 0), _base(1)
+    {
+        // Reserve the node arena and heap up front
+        _nodes.reserve(_budget);
+        _heap.reserve(_budget * 6);
+    }
+    inline void reset()
+    {
+        // Invalidate all stamps
+        std::fill(_visit.begin(), _visit.end(), 0);
+        _base = 1;
+    }
+    inline size_t get_budget() const
+    {
+        return _budget;
+    }
+    template <typename F>
+    inline bool search(std::vector<size_t> &path, const size_t start_key, const size_t stop_key, const size_t limit, const F &is_open)
+    {
+        // Clear the old path
+        path.clear();
+
+        // Clear the arena and heap, keep the memory
+        _nodes.clear();
+        _heap.clear();
+
+        // Push the start node
+        push(start_key, _no_parent, 0, stop_key);
+
+        // Track the node closest to the goal in case we run out of budget
+        uint32_t best = 0;
+        bool found = false;
+
+        // Search until the open set is empty
+        while (!_heap.empty())
+        {
+            // Pop the cheapest node
+            std::pop_heap(_heap.begin(), _heap.end(), heap_compare);
+            const heap_entry top = _heap.back();
+            _heap.pop_back();
+
+            // Skip stale heap entries
+            astar_node &node = _nodes[top.second];
+            if (node.is_closed() || top.first != node.f())
+            {
+                continue;
+            }
+
+            // Close this node
+            node.close();
+
+            // Check if we made it to the mother lands!
+            if (node.key() == stop_key)
+            {
+                best = top.second;
+                found = true;
+                break;
+            }
+
+            // Remember the closest node to the goal
+            if (node.h() < _nodes[best].h())
+            {
+                best = top.second;
+            }
+
+            // Search all neighboring cells
+            expand(top.second, stop_key, is_open);
+        }
+
+        // Extract the path to the goal or the closest approach
+        trace(path, best, limit);
+
+        // Reuse stamps without clearing the visit buffer
+        next_generation();
+
+        return found;
+    }
+    inline bool search(std::vector<size_t> &path, const std::vector<block_id> &grid,
+                       const size_t start_key, const size_t stop_key, const size_t limit)
+    {
+        // Only empty cells can be traversed
+        const auto is_open = [&grid](const size_t key) -> bool {
+            return grid[key] == block_id::EMPTY;
+        };
+
+        return search(path, start_key, stop_key, limit, is_open);
+    }
+};
+}
+
+#endif
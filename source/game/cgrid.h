@@ -18,20 +18,25 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __CHUNK_GRID__
 #define __CHUNK_GRID__
 
+#include <algorithm>
 #include <chrono>
+#include <game/astar.h>
 #include <game/callback.h>
 #include <game/cgrid_generator.h>
-#include <game/file.h>
+#include <game/chunk_graph.h>
+#include <game/flow_field.h>
 #include <game/id.h>
 #include <game/swatch.h>
 #include <game/terrain_mesher.h>
+#include <game/world_file.h>
+#include <game/world_seed.h>
 #include <min/aabbox.h>
 #include <min/camera.h>
 #include <min/intersect.h>
 #include <min/mesh.h>
 #include <min/ray.h>
-#include <min/serial.h>
 #include <min/utility.h>
+#include <numeric>
 #include <stdexcept>
 
 namespace game
@@ -67,25 +72,98 @@ class view_chunk
     }
 };
 
+class grid_region
+{
+  private:
+    size_t _low[3];
+    size_t _count[3];
+    bool _reverse[3];
+
+    static inline void walk(const size_t t, const unsigned length, const int offset, const size_t end,
+                            size_t &low, size_t &count, bool &reverse)
+    {
+        // Walk toward positive or negative axis, prune cells outside the grid
+        reverse = offset < 0;
+        if (t >= end)
+        {
+            low = 0;
+            count = 0;
+        }
+        else if (reverse)
+        {
+            count = std::min(static_cast<size_t>(length), t + 1);
+            low = t + 1 - count;
+        }
+        else
+        {
+            count = std::min(static_cast<size_t>(length), end - t);
+            low = t;
+        }
+    }
+
+  public:
+    grid_region(const std::tuple<size_t, size_t, size_t> &t, const min::vec3<unsigned> &length, const min::vec3<int> &offset, const size_t end)
+    {
+        walk(std::get<0>(t), length.x(), offset.x(), end, _low[0], _count[0], _reverse[0]);
+        walk(std::get<1>(t), length.y(), offset.y(), end, _low[1], _count[1], _reverse[1]);
+        walk(std::get<2>(t), length.z(), offset.z(), end, _low[2], _count[2], _reverse[2]);
+    }
+    inline size_t count(const size_t axis) const
+    {
+        return _count[axis];
+    }
+    inline size_t high(const size_t axis) const
+    {
+        return _low[axis] + _count[axis] - 1;
+    }
+    inline size_t index(const size_t axis, const size_t i) const
+    {
+        // Grid index of the i'th cell walked along this axis
+        return _reverse[axis] ? high(axis) - i : _low[axis] + i;
+    }
+    inline bool is_empty() const
+    {
+        return _count[0] == 0 || _count[1] == 0 || _count[2] == 0;
+    }
+    inline bool is_reverse(const size_t axis) const
+    {
+        return _reverse[axis];
+    }
+    inline size_t low(const size_t axis) const
+    {
+        return _low[axis];
+    }
+};
+
 class cgrid
 {
   private:
     constexpr static size_t _search_limit = 20;
+    constexpr static size_t _search_budget = 2048;
+    constexpr static size_t _page_budget = 32;
     const size_t _grid_scale;
     std::vector<block_id> _grid;
-    std::vector<int_fast8_t> _visit;
-    std::vector<std::pair<size_t, float>> _neighbors;
+    astar _astar;
     std::vector<size_t> _path;
-    std::vector<size_t> _stack;
     const size_t _chunk_cells;
     const size_t _chunk_size;
     const size_t _chunk_scale;
+    chunk_graph _graph;
     std::vector<min::mesh<float, uint32_t>> _chunks;
     std::vector<bool> _chunk_update;
-    std::vector<size_t> _chunk_update_keys;
-    std::vector<size_t> _sort_chunk;
+    std::vector<bool> _chunk_dirty;
+    std::vector<size_t> _chunk_dirty_keys;
+    std::vector<uint32_t> _chunk_gen;
+    world_file _file;
+    std::vector<bool> _chunk_paged;
+    std::vector<size_t> _page_queue;
+    std::vector<size_t> _page_keys;
+    size_t _page_head;
+    bool _page_sorted;
     std::vector<view_chunk> _view_chunks;
-    mutable std::vector<size_t> _overlap;
+    mutable std::vector<uint8_t> _merge;
+    std::vector<std::pair<size_t, block_id>> _removed;
+    std::vector<block_id> _region_buffer;
     size_t _recent_chunk;
     min::vec3<float> _recent_p;
     const size_t _view_chunk_size;
@@ -93,8 +171,11 @@ class cgrid
     const float _view_dist;
     const min::aabbox<float, min::vec3> _world;
     const min::vec3<float> _cell_extent;
+    world_seed _seed;
     cgrid_generator _generator;
     terrain_mesher _mesher;
+    mutable std::vector<std::vector<min::vec4<float>>> _preview_cells;
+    flow_field _flow;
 
     static inline bool in_x(const min::vec3<float> &p, const min::vec3<float> &min, const min::vec3<float> &max)
     {
@@ -133,26 +214,104 @@ class cgrid
         return min::aabbox<float, min::vec3>(minv, maxv);
     }
     inline void collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out,
-                                const min::aabbox<float, min::vec3> &box, const min::vec3<float> &center) const
-    {
-        // Get all overlapping cells
-        min::vec3<float>::grid_overlap(_overlap, _world.get_min(), _cell_extent, _grid_scale, box.get_min(), box.get_max());
+                                const min::aabbox<float, min::vec3> &box) const
+    {
+        // Get the cell range overlapping the box
+        const size_t lx = grid_clamp_index(box.get_min().x(), _world.get_min().x());
+        const size_t ly = grid_clamp_index(box.get_min().y(), _world.get_min().y());
+        const size_t lz = grid_clamp_index(box.get_min().z(), _world.get_min().z());
+        const size_t dx = grid_clamp_index(box.get_max().x(), _world.get_min().x()) - lx + 1;
+        const size_t dy = grid_clamp_index(box.get_max().y(), _world.get_min().y()) - ly + 1;
+        const size_t dz = grid_clamp_index(box.get_max().z(), _world.get_min().z()) - lz + 1;
+
+        // Clear the merged flags for this region
+        _merge.assign(dx * dy * dz, 0);
+
+        // Function to test if a region cell can join the current box
+        const auto join = [this, lx, ly, lz, dy, dz](const size_t i, const size_t j, const size_t k) -> bool {
+            const block_id value = _grid[grid_key_pack(std::make_tuple(lx + i, ly + j, lz + k))];
+            return _merge[(i * dy + j) * dz + k] == 0 && value != block_id::EMPTY && value != block_id::SODIUM;
+        };
 
-        // Create boxes of all overlapping cells
-        const size_t size = _overlap.size();
-        for (size_t i = 0; i < size; i++)
+        // Greedily grow boxes along z, then y, then x
+        for (size_t i = 0; i < dx; i++)
         {
-            // Get the cell key
-            const size_t key = _overlap[i];
-
-            // Check if valid and if the cell is not empty
-            if (_grid[key] != block_id::EMPTY)
+            for (size_t j = 0; j < dy; j++)
             {
-                // Create box at this point
-                const min::aabbox<float, min::vec3> grid = grid_box(grid_cell_center(key));
+                for (size_t k = 0; k < dz; k++)
+                {
+                    // Skip empty or already merged cells
+                    const block_id atlas = _grid[grid_key_pack(std::make_tuple(lx + i, ly + j, lz + k))];
+                    if (atlas == block_id::EMPTY || _merge[(i * dy + j) * dz + k] != 0)
+                    {
+                        continue;
+                    }
+
+                    // Sodium cells explode at their center, never merge them
+                    // Merged boxes report the block of their first cell
+                    size_t ei = i + 1;
+                    size_t ej = j + 1;
+                    size_t ek = k + 1;
+                    if (atlas != block_id::SODIUM)
+                    {
+                        // Grow along z axis
+                        while (ek < dz && join(i, j, ek))
+                        {
+                            ek++;
+                        }
+
+                        // Grow along y axis while the whole row matches
+                        const auto row = [&join, k, ek](const size_t x, const size_t y) -> bool {
+                            for (size_t z = k; z < ek; z++)
+                            {
+                                if (!join(x, y, z))
+                                {
+                                    return false;
+                                }
+                            }
+                            return true;
+                        };
+                        while (ej < dy && row(i, ej))
+                        {
+                            ej++;
+                        }
+
+                        // Grow along x axis while the whole slab matches
+                        const auto slab = [&row, j, &ej](const size_t x) -> bool {
+                            for (size_t y = j; y < ej; y++)
+                            {
+                                if (!row(x, y))
+                                {
+                                    return false;
+                                }
+                            }
+                            return true;
+                        };
+                        while (ei < dx && slab(ei))
+                        {
+                            ei++;
+                        }
+                    }
 
-                // Add box and grid value to
-                out.emplace_back(grid, _grid[key]);
+                    // Flag all cells in the box as merged
+                    for (size_t x = i; x < ei; x++)
+                    {
+                        for (size_t y = j; y < ej; y++)
+                        {
+                            for (size_t z = k; z < ek; z++)
+                            {
+                                _merge[(x * dy + y) * dz + z] = 1;
+                            }
+                        }
+                    }
+
+                    // Create box spanning all merged cells
+                    const min::vec3<float> min = grid_cell(std::make_tuple(lx + i, ly + j, lz + k));
+                    const min::vec3<float> max = min + min::vec3<float>(ei - i, ej - j, ek - k);
+
+                    // Add box and grid value
+                    out.emplace_back(min::aabbox<float, min::vec3>(min, max), atlas);
+                }
             }
         }
     }
@@ -230,6 +389,18 @@ class cgrid
             }
         }
     }
+    template <typename I>
+    static inline size_t count_equal(const block_id *const row, const size_t n, I it)
+    {
+        // Count cells in row equal to the other sequence
+        size_t out = 0;
+        for (size_t k = 0; k < n; k++, ++it)
+        {
+            out += (row[k] == *it);
+        }
+
+        return out;
+    }
     inline min::aabbox<float, min::vec3> create_chunk_box(const min::vec3<float> &chunk_start) const
     {
         // Create box at chunk_start
@@ -296,6 +467,12 @@ class cgrid
 
         return min::vec3<float>(x, y, z);
     }
+    inline size_t grid_clamp_index(const float v, const float min) const
+    {
+        // Index of the cell containing v, clamped to the grid
+        const float f = std::floor(v - min);
+        return (f <= 0.0) ? 0 : std::min(static_cast<size_t>(f), _grid_scale - 1);
+    }
     inline size_t grid_key_pack(const std::tuple<size_t, size_t, size_t> &t) const
     {
         return min::vec3<float>::grid_key(t, _grid_scale);
@@ -399,6 +576,12 @@ class cgrid
         // Generate mesh
         _mesher.generate_chunk(_chunks[chunk_key]);
 
+        // Relink the navigation graph for this chunk
+        _graph.update(chunk_key, _grid);
+
+        // Terrain changed so the flow field is stale
+        _flow.invalidate();
+
         // Flag that the chunk needs to be updated
         _chunk_update[chunk_key] = true;
     }
@@ -416,131 +599,421 @@ class cgrid
     inline unsigned geometry_add(const min::vec3<float> &start, const min::vec3<unsigned> &length,
                                  const min::vec3<int> &offset, const block_id atlas_id)
     {
-        unsigned out = 0;
+        // Fill the region with atlas
+        return region_fill(make_region(start, length, offset), atlas_id);
+    }
+    inline unsigned geometry_copy_swatch(const swatch &sw, const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset)
+    {
+        // Function to get the swatch row for region row
+        const auto row = [&sw](const size_t i, const size_t j) -> const block_id * {
+            return sw.read_row(i, j);
+        };
 
-        // Create cubic function, for each cell in cubic space
-        const auto f = [this, &out, atlas_id](const size_t i, const size_t j, const size_t k, const size_t key) {
-            // Count changed blocks
-            if (_grid[key] != atlas_id)
+        // Copy the swatch into the region
+        return region_load(make_region(start, length, offset), row);
+    }
+    template <typename SB>
+    inline unsigned geometry_remove(const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset,
+                                    const SB &set_block_call)
+    {
+        // Clear the region
+        return region_clear(make_region(start, length, offset), set_block_call);
+    }
+    inline void generate_portal()
+    {
+        // Function for finding grid key index
+        const auto f = [this](const std::tuple<size_t, size_t, size_t> &t) -> size_t {
+            return grid_key_pack(t);
+        };
+
+        // Function for finding grid center
+        const auto g = [this](const size_t key) -> min::vec3<float> {
+            return grid_cell_center(key);
+        };
+
+        // Chunks of the cgrid are generated as they are paged in
+        _generator.prepare_portal(_grid, f, g, _seed.seed());
+    }
+    inline void generate_world()
+    {
+        // Chunks of the cgrid are generated as they are paged in
+        _generator.prepare_world(_grid, _seed.seed());
+    }
+    inline float grid_center_square_dist(const size_t key, const min::vec3<float> &point) const
+    {
+        // Calculate vector between points
+        const min::vec3<float> dv = grid_cell_center(key) - point;
+
+        // Calculate the square distance to this point
+        return dv.dot(dv);
+    }
+    inline grid_region make_region(const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset) const
+    {
+        // Begin at start position, clamp out of bound to world boundary
+        const min::vec3<float> bounded = min::vec3<float>(start).clamp(_world.get_min(), _world.get_max());
+
+        // Get the grid axis components
+        const auto t = min::vec3<float>::grid_index(_world.get_min(), _cell_extent, bounded);
+
+        // Create region, edits always walk adjacent cells along the offset direction
+        return grid_region(t, length, offset, _grid_scale);
+    }
+    template <typename F>
+    inline void region_rows(const grid_region &r, const F &f) const
+    {
+        // For each row along z axis, rows are contiguous in the grid
+        const size_t xn = r.count(0);
+        const size_t yn = r.count(1);
+        for (size_t i = 0; i < xn; i++)
+        {
+            const size_t x = r.index(0, i);
+            for (size_t j = 0; j < yn; j++)
+            {
+                const size_t y = r.index(1, j);
+
+                // Pass region row and start key of the grid row
+                f(i, j, grid_key_pack(std::make_tuple(x, y, r.low(2))));
+            }
+        }
+    }
+    inline void region_dirty(const grid_region &r)
+    {
+        // Expand by one cell to update faces of neighboring chunks
+        const size_t edge = _grid_scale - 1;
+        const size_t lx = (r.low(0) > 0) ? r.low(0) - 1 : 0;
+        const size_t ly = (r.low(1) > 0) ? r.low(1) - 1 : 0;
+        const size_t lz = (r.low(2) > 0) ? r.low(2) - 1 : 0;
+        const size_t hx = std::min(r.high(0) + 1, edge);
+        const size_t hy = std::min(r.high(1) + 1, edge);
+        const size_t hz = std::min(r.high(2) + 1, edge);
+
+        // Flag each overlapped chunk once
+        for (size_t cx = lx / _chunk_size; cx <= hx / _chunk_size; cx++)
+        {
+            for (size_t cy = ly / _chunk_size; cy <= hy / _chunk_size; cy++)
             {
-                // Increment the out counter
-                out++;
+                for (size_t cz = lz / _chunk_size; cz <= hz / _chunk_size; cz++)
+                {
+                    set_chunk_dirty((cx * _chunk_scale * _chunk_scale) + (cy * _chunk_scale) + cz);
+                }
+            }
+        }
+    }
+    inline void queue_chunk_update(const size_t chunk_key)
+    {
+        // Only record each dirty chunk once
+        if (!_chunk_dirty[chunk_key])
+        {
+            _chunk_dirty[chunk_key] = true;
+            _chunk_dirty_keys.push_back(chunk_key);
+        }
+    }
+    inline void page_chunk(const size_t chunk_key)
+    {
+        // Queue the chunk if it isn't generated yet
+        if (!_chunk_paged[chunk_key])
+        {
+            _page_keys.push_back(chunk_key);
+        }
+    }
+    inline void page_fence()
+    {
+        // Ungenerated chunks are solid stone so nothing falls into them
+        const auto work = [this](std::mt19937 &, const size_t i) {
+            const size_t row = i * _grid_scale;
+            std::fill(_grid.begin() + row, _grid.begin() + row + _grid_scale, block_id::STONE2);
+        };
+        work_queue::worker.run(std::cref(work), 0, _grid_scale * _grid_scale);
+    }
+    inline void page_finish()
+    {
+        // Everything is in memory, release the world file and the generator stages
+        _file.close();
+        _generator.finish();
+        _page_queue.clear();
+        _page_head = 0;
+    }
+    inline void page_keys()
+    {
+        // If there are chunks to generate
+        if (_page_keys.empty())
+        {
+            return;
+        }
+
+        // Map the world file again if a save released it
+        _file.reopen();
 
-                // Set the geometry cell with value
-                geometry_set_cell(key, atlas_id);
+        // Generate the queued chunks in parallel, then apply saved changes on top
+        const auto work = [this](std::mt19937 &, const size_t i) {
+            const size_t key = _page_keys[i];
+            _generator.generate_chunk(_grid, key);
+            if (_file.is_open())
+            {
+                _file.load_chunk(_grid, key);
             }
         };
+        work_queue::worker.run(std::cref(work), 0, _page_keys.size());
 
-        // Run the function
-        cubic_grid(start, length, offset, f);
+        // Mesh the new chunks
+        for (const size_t key : _page_keys)
+        {
+            _chunk_paged[key] = true;
+            page_mesh(key);
+        }
+        _page_keys.clear();
 
-        // Return count
-        return out;
+        // Release the world file and generator when done
+        if (_page_head < _page_queue.size())
+        {
+            while (_page_head < _page_queue.size() && _chunk_paged[_page_queue[_page_head]])
+            {
+                _page_head++;
+            }
+            if (_page_head >= _page_queue.size())
+            {
+                page_finish();
+            }
+        }
     }
-    inline unsigned geometry_copy_swatch(const swatch &sw, const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset)
+    inline void page_reset()
     {
-        unsigned out = 0;
+        // Nothing is generated, every chunk waits to be paged in
+        const size_t chunks = _chunks.size();
+        _file.close();
+        _generator.reset();
+        _chunk_paged.assign(chunks, false);
+        _page_queue.resize(chunks);
+        std::iota(_page_queue.begin(), _page_queue.end(), 0);
+        _page_keys.clear();
+        _page_head = 0;
+        _page_sorted = false;
+
+        // Fence off the whole world until it is generated
+        page_fence();
+    }
+    inline void page_mesh(const size_t chunk_key)
+    {
+        // Mesh the new chunk
+        queue_chunk_update(chunk_key);
+
+        // Unpack chunk key to components
+        const size_t scale2 = _chunk_scale * _chunk_scale;
+        const size_t cx = chunk_key / scale2;
+        const size_t cy = (chunk_key / _chunk_scale) % _chunk_scale;
+        const size_t cz = chunk_key % _chunk_scale;
+        const size_t edge = _chunk_scale - 1;
+
+        // Function to remesh faces of neighbors that were already paged
+        const auto neighbor = [this](const size_t key) {
+            if (_chunk_paged[key])
+            {
+                queue_chunk_update(key);
+            }
+        };
 
-        // Create cubic function, for each cell in cubic space
-        const auto f = [this, &out, &sw](const size_t i, const size_t j, const size_t k, const size_t key) {
-            // Count changed blocks
-            const block_id value = sw.get(i, j, k);
-            if (_grid[key] != value)
+        // Faces are ordered -x, +x, -y, +y, -z, +z
+        if (cx != 0)
+        {
+            neighbor(chunk_key - scale2);
+        }
+        if (cx != edge)
+        {
+            neighbor(chunk_key + scale2);
+        }
+        if (cy != 0)
+        {
+            neighbor(chunk_key - _chunk_scale);
+        }
+        if (cy != edge)
+        {
+            neighbor(chunk_key + _chunk_scale);
+        }
+        if (cz != 0)
+        {
+            neighbor(chunk_key - 1);
+        }
+        if (cz != edge)
+        {
+            neighbor(chunk_key + 1);
+        }
+    }
+    inline void region_page(const grid_region &r)
+    {
+        // Only while chunks are still waiting to be generated
+        if (_page_head < _page_queue.size())
+        {
+            for (size_t cx = r.low(0) / _chunk_size; cx <= r.high(0) / _chunk_size; cx++)
             {
-                // Increment the out counter
-                out++;
+                for (size_t cy = r.low(1) / _chunk_size; cy <= r.high(1) / _chunk_size; cy++)
+                {
+                    for (size_t cz = r.low(2) / _chunk_size; cz <= r.high(2) / _chunk_size; cz++)
+                    {
+                        page_chunk((cx * _chunk_scale * _chunk_scale) + (cy * _chunk_scale) + cz);
+                    }
+                }
+            }
+            page_keys();
+        }
+    }
+    template <typename SB>
+    inline unsigned region_clear(const grid_region &r, const SB &set_block_call)
+    {
+        // Skip regions outside the grid
+        if (r.is_empty())
+        {
+            return 0;
+        }
 
-                // Set the geometry cell with value
-                geometry_set_cell(key, value);
+        // Read chunks from file before touching them
+        region_page(r);
 
-                // If we are removing blocks, add boundary cells for update
-                if (value == block_id::EMPTY)
+        // Record removed blocks and clear each row
+        _removed.clear();
+        const size_t n = r.count(2);
+        const auto f = [this, n](const size_t, const size_t, const size_t key) {
+            block_id *const row = &_grid[key];
+            for (size_t k = 0; k < n; k++)
+            {
+                if (row[k] != block_id::EMPTY)
                 {
-                    set_boundary_chunk(key);
+                    _removed.emplace_back(key + k, row[k]);
                 }
             }
+
+            // Clear the row
+            std::fill(row, row + n, block_id::EMPTY);
         };
 
         // Run the function
-        cubic_grid(start, length, offset, f);
+        region_rows(r, f);
+
+        // Update chunks and fire the callbacks once the grid is consistent
+        const unsigned out = _removed.size();
+        if (out > 0)
+        {
+            region_dirty(r);
+            for (const auto &rm : _removed)
+            {
+                set_block_call(grid_cell_center(rm.first), rm.second);
+            }
+        }
 
         // Return count
         return out;
     }
-    template <typename SB>
-    inline unsigned geometry_remove(const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset,
-                                    const block_id atlas_id, const SB &set_block_call)
+    inline unsigned region_fill(const grid_region &r, const block_id atlas)
     {
+        // Skip regions outside the grid
+        if (r.is_empty())
+        {
+            return 0;
+        }
+
+        // Read chunks from file before touching them
+        region_page(r);
+
+        // Count changed blocks and fill each row
         unsigned out = 0;
+        const size_t n = r.count(2);
+        const auto f = [this, &out, n, atlas](const size_t, const size_t, const size_t key) {
+            block_id *const row = &_grid[key];
+            out += n - std::count(row, row + n, atlas);
+            std::fill(row, row + n, atlas);
+        };
 
-        // Create cubic function, for each cell in cubic space
-        const auto f = [this, &out, atlas_id, &set_block_call](const size_t i, const size_t j, const size_t k, const size_t key) {
-            // Get the old value
-            const block_id old_value = _grid[key];
+        // Run the function
+        region_rows(r, f);
 
-            // Count changed blocks
-            if (_grid[key] != atlas_id)
-            {
-                // Increment the out counter
-                out++;
+        // Update chunks
+        if (out > 0)
+        {
+            region_dirty(r);
+        }
 
-                // Set the geometry cell with value
-                const min::vec3<float> p = geometry_set_cell(key, atlas_id);
+        // Return count
+        return out;
+    }
+    template <typename R>
+    inline unsigned region_load(const grid_region &r, const R &src_row)
+    {
+        // Skip regions outside the grid
+        if (r.is_empty())
+        {
+            return 0;
+        }
 
-                // If we are removing blocks, add boundary cells for update
-                set_boundary_chunk(key);
+        // Read chunks from file before touching them
+        region_page(r);
 
-                // Callback on cell
-                set_block_call(p, old_value);
+        // Count changed blocks and copy each row from the buffer
+        unsigned out = 0;
+        const size_t n = r.count(2);
+        const bool reverse = r.is_reverse(2);
+        const auto f = [this, &out, &src_row, n, reverse](const size_t i, const size_t j, const size_t key) {
+            block_id *const row = &_grid[key];
+            const block_id *const src = src_row(i, j);
+            if (reverse)
+            {
+                out += n - count_equal(row, n, std::reverse_iterator<const block_id *>(src + n));
+                std::reverse_copy(src, src + n, row);
+            }
+            else
+            {
+                out += n - count_equal(row, n, src);
+                std::copy(src, src + n, row);
             }
         };
 
         // Run the function
-        cubic_grid(start, length, offset, f);
+        region_rows(r, f);
+
+        // Update chunks
+        if (out > 0)
+        {
+            region_dirty(r);
+        }
 
         // Return count
         return out;
     }
-    inline min::vec3<float> geometry_set_cell(const size_t key, const block_id value)
+    template <typename R>
+    inline unsigned region_store(const grid_region &r, const R &dst_row)
     {
-        // Get the chunk key for updating
-        const min::vec3<float> p = grid_cell_center(key);
-        const size_t ckey = chunk_key_unsafe(p);
-        _chunk_update_keys.push_back(ckey);
+        // Read chunks from file before touching them
+        region_page(r);
 
-        // Set the cell with value
-        _grid[key] = value;
-
-        // Return position
-        return p;
-    }
-    inline void generate_portal()
-    {
-        // Function for finding grid key index
-        const auto f = [this](const std::tuple<size_t, size_t, size_t> &t) -> size_t {
-            return grid_key_pack(t);
-        };
+        // Count ether cost and copy each row into the buffer
+        unsigned out = 0;
+        const size_t n = r.count(2);
+        const bool reverse = r.is_reverse(2);
+        const auto f = [this, &out, &dst_row, n, reverse](const size_t i, const size_t j, const size_t key) {
+            const block_id *const row = &_grid[key];
+            block_id *const dst = dst_row(i, j);
+            if (reverse)
+            {
+                std::reverse_copy(row, row + n, dst);
+            }
+            else
+            {
+                std::copy(row, row + n, dst);
+            }
 
-        // Function for finding grid center
-        const auto g = [this](const size_t key) -> min::vec3<float> {
-            return grid_cell_center(key);
+            // Count ether cost
+            for (size_t k = 0; k < n; k++)
+            {
+                out += ether_cost(row[k]);
+            }
         };
 
-        // Generate the cgrid data
-        _generator.generate_portal(_grid, _grid_scale, _chunk_size, f, g);
-    }
-    inline void generate_world()
-    {
-        // Generate the cgrid data
-        _generator.generate_world(_grid, _grid_scale, _chunk_size);
-    }
-    inline float grid_center_square_dist(const size_t key, const min::vec3<float> &point) const
-    {
-        // Calculate vector between points
-        const min::vec3<float> dv = grid_cell_center(key) - point;
+        // Run the function
+        if (!r.is_empty())
+        {
+            region_rows(r, f);
+        }
 
-        // Calculate the square distance to this point
-        return dv.dot(dv);
+        // Return the cost
+        return out;
     }
     inline bool inside(const min::vec3<float> &p) const
     {
@@ -583,10 +1056,11 @@ class cgrid
     }
     inline void reserve_memory()
     {
-        _path.reserve(20);
-        _neighbors.reserve(6);
-        _stack.reserve(100);
-        _sort_chunk.reserve(27);
+        _path.reserve(_search_budget);
+        _merge.reserve(64);
+        _chunk_dirty_keys.reserve(_chunks.size());
+        _page_queue.reserve(_chunks.size());
+        _page_keys.reserve(_chunks.size());
         _view_chunks.reserve(27);
     }
     inline void search(const min::vec3<float> &start, const min::vec3<float> &stop)
@@ -602,205 +1076,61 @@ class cgrid
             return;
         }
 
-        // Clear the old neighbors
-        _neighbors.clear();
-
         // Clear the old path
         _path.clear();
 
-        // Clear the old stack
-        _stack.clear();
-
         // If the start key is inside terrain
         if (_grid[start_key] != block_id::EMPTY)
         {
             return;
         }
 
-        // Reset the visited flag
-        std::fill(_visit.begin(), _visit.end(), -1);
-
-        // If we need to search
+        // If we need to search, returns the closest approach if budget runs out
         if (start_key != stop_key)
         {
-            // Push the start_key on the stack
-            _stack.push_back(start_key);
-
-            // Flag that we pushed this key
-            _visit[start_key] = 1;
-
-            // Iteratively Search for a path
-            while (!_stack.empty())
+            // Follow the shared flow field if it leads to the destination
+            if (_flow.path(_path, start_key, stop_key, _search_limit))
             {
-                const bool found = search_next(stop, stop_key);
-                if (found)
-                {
-                    break;
-                }
+                return;
             }
-        }
-    }
-    inline void search_neighbors(const std::tuple<size_t, size_t, size_t> &comp, const min::vec3<float> &stop)
-    {
-        // Clear neighbors buffer
-        _neighbors.clear();
-
-        // Unpack start_key to components
-        const size_t x = std::get<0>(comp);
-        const size_t y = std::get<1>(comp);
-        const size_t z = std::get<2>(comp);
-
-        // Check against lower x grid dimensions
-        const size_t edge = _grid_scale - 1;
-        if (x != 0)
-        {
-            const size_t nxk = min::vec3<float>::grid_key(std::make_tuple(x - 1, y, z), _grid_scale);
-            _neighbors.push_back({nxk, grid_center_square_dist(nxk, stop)});
-        }
-
-        // Check against upper x grid dimensions
-        if (x != edge)
-        {
-            const size_t pxk = min::vec3<float>::grid_key(std::make_tuple(x + 1, y, z), _grid_scale);
-            _neighbors.push_back({pxk, grid_center_square_dist(pxk, stop)});
-        }
-
-        // Check against lower y grid dimensions
-        if (y != 0)
-        {
-            const size_t nyk = min::vec3<float>::grid_key(std::make_tuple(x, y - 1, z), _grid_scale);
-            _neighbors.push_back({nyk, grid_center_square_dist(nyk, stop)});
-        }
-
-        // Check against upper y grid dimensions
-        if (y != edge)
-        {
-            const size_t pyk = min::vec3<float>::grid_key(std::make_tuple(x, y + 1, z), _grid_scale);
-            _neighbors.push_back({pyk, grid_center_square_dist(pyk, stop)});
-        }
-
-        // Check against lower z grid dimensions
-        if (z != 0)
-        {
-            const size_t nzk = min::vec3<float>::grid_key(std::make_tuple(x, y, z - 1), _grid_scale);
-            _neighbors.push_back({nzk, grid_center_square_dist(nzk, stop)});
-        }
-
-        // Check against upper z grid dimensions
-        if (z != edge)
-        {
-            const size_t pzk = min::vec3<float>::grid_key(std::make_tuple(x, y, z + 1), _grid_scale);
-            _neighbors.push_back({pzk, grid_center_square_dist(pzk, stop)});
-        }
-
-        // lambda function to create sorted array indices based on distance
-        std::sort(_neighbors.begin(), _neighbors.end(), [](const std::pair<size_t, float> &a, const std::pair<size_t, float> &b) {
-            return a.second > b.second;
-        });
-    }
-    inline bool search_next(const min::vec3<float> &stop, const size_t stop_key)
-    {
-        // Check if stack is empty to avoid stomping the stack
-        if (_stack.size() == 0)
-        {
-            return true;
-        }
-        else if (_path.size() > _search_limit)
-        {
-            return true;
-        }
-
-        // Get element on top of stack
-        const size_t key = _stack.back();
-
-        // Check if we made it to the mother lands!
-        if (key == stop_key)
-        {
-            // Store end point of path
-            _path.push_back(key);
-
-            // Stop searching
-            return true;
-        }
-        else if (_visit[key] == 1)
-        {
-            // If we haven't seen this node yet, we are traversing
-            _path.push_back(key);
-
-            // Visit this node
-            _visit[key] = 0;
-
-            // Search along the gradient until we hit a wall
-            const std::tuple<size_t, size_t, size_t> comp = grid_key_unpack(key);
-
-            // Search all neighboring cells
-            search_neighbors(comp, stop);
 
-            for (const auto &n : _neighbors)
-            {
-                // If we haven't visited the neighbor cell, and it isn't a wall
-                if (_visit[n.first] == -1 && _grid[n.first] == block_id::EMPTY)
-                {
-                    // Flag that we pushed this key to prevent duplicates on stack
-                    _visit[n.first] = 1;
-
-                    // Calculate distance to destination
-                    _stack.push_back(n.first);
-                }
-            }
-        }
-        else if (_visit[key] == 0)
-        {
-            // If we already visited this node, we must be unwinding so pop stack
-            _stack.pop_back();
+            // Route through the chunk graph and only search to the next chunk
+            size_t goal_key = stop_key;
+            _graph.next_portal(start_key, stop_key, goal_key);
 
-            // Every time we visit we push so we must pop here
-            _path.pop_back();
+            // Search for a path to the goal
+            _astar.search(_path, _grid, start_key, goal_key, _search_limit);
         }
-
-        // Keepp looking for a path
-        return false;
     }
     inline void world_load()
     {
-        // Create output stream for loading world
-        std::vector<uint8_t> stream;
+        // Fence off the world and queue every chunk to be generated, nearest to the player first
+        _graph.reset();
+        page_reset();
 
-        // Load data into stream from file
-        load_file("bin/world.bmesh", stream);
-
-        // If load failed dont try to parse stream data
-        if (stream.size() != 0)
+        // Generate the world from the seed a chunk at a time, the save only stores changes
+        if (_seed.is_portal())
         {
-            // Load grid with file
-            size_t next = 0;
-            const std::vector<block_id> grid = min::read_le_vector<block_id>(stream, next);
-
-            // Check that grid load correctly
-            const size_t cubic_size = _grid_scale * _grid_scale * _grid_scale;
-            if (grid.size() == cubic_size)
-            {
-                // Copy grid from file
-                _grid = grid;
-            }
-            else
-            {
-                // Grid is wrong dimensions so regenerate world
-                generate_world();
-            }
+            generate_portal();
         }
         else
         {
-            // Else generate world
             generate_world();
         }
 
-        // Reserve and update all chunks
+        // Map the world file, modified chunks are applied as they are generated
+        if (!_file.open(_chunk_gen, _seed) && _file.is_legacy())
+        {
+            // Old saves are the whole grid, read it on top of the generated world
+            page_all();
+            _file.load(_grid, _chunk_gen, _seed);
+        }
+
+        // Reserve all chunks in memory
         const size_t chunks = _chunks.size();
         for (size_t i = 0; i < chunks; i++)
         {
             chunk_warm(i);
-            chunk_update(i);
         }
     }
 
@@ -808,22 +1138,30 @@ class cgrid
     constexpr static float _player_dx = 0.45;
     constexpr static float _player_dy = 0.95;
     constexpr static float _player_dz = 0.45;
-    cgrid(const size_t chunk_size, const size_t grid_scale, const size_t view_chunk_size)
+    cgrid(const size_t chunk_size, const size_t grid_scale, const size_t view_chunk_size, const world_seed &seed)
         : _grid_scale(grid_scale * 2),
           _grid(_grid_scale * _grid_scale * _grid_scale, block_id::EMPTY),
-          _visit(_grid.size(), -1),
+          _astar(_grid_scale, _search_budget),
           _chunk_cells(chunk_size * chunk_size * chunk_size),
           _chunk_size(chunk_size),
           _chunk_scale(_grid_scale / _chunk_size),
+          _graph(_grid_scale, _chunk_size),
           _chunks(_chunk_scale * _chunk_scale * _chunk_scale, min::mesh<float, uint32_t>("chunk")),
           _chunk_update(_chunks.size(), true),
+          _chunk_dirty(_chunks.size(), false),
+          _chunk_gen(_chunks.size(), 0),
+          _file("bin/world.bmesh", _grid_scale, _chunk_size),
+          _chunk_paged(_chunks.size(), true),
+          _page_head(0), _page_sorted(false),
           _recent_chunk(0),
           _view_chunk_size(view_chunk_size),
           _view_half_width(_view_chunk_size / 2),
           _view_dist(calculate_view_distance()),
           _world(calculate_world_size(grid_scale)),
           _cell_extent(1.0, 1.0, 1.0),
-          _generator(_grid), _mesher(chunk_size)
+          _seed(seed), _generator(_grid_scale, _chunk_size), _mesher(chunk_size),
+          _preview_cells(swatch::max_scale()),
+          _flow(_grid_scale, _view_chunk_size * _chunk_size)
     {
         // Check chunk size
         if (grid_scale % chunk_size != 0)
@@ -849,16 +1187,18 @@ class cgrid
         // Reserve memory
         reserve_memory();
     }
-    inline void reset()
+    inline void reset(const world_seed &seed)
     {
+        // Use the seed of the loaded world
+        _seed = seed;
+
         // Clear out all vectors
-        _visit.clear();
-        _neighbors.clear();
+        _astar.reset();
+        _flow.invalidate();
         _path.clear();
-        _stack.clear();
-        _chunk_update.clear();
-        _chunk_update_keys.clear();
-        _sort_chunk.clear();
+        _chunk_update.assign(_chunks.size(), true);
+        _chunk_dirty.assign(_chunks.size(), false);
+        _chunk_dirty_keys.clear();
         _view_chunks.clear();
 
         // Reload the world
@@ -941,7 +1281,7 @@ class cgrid
             const min::aabbox<float, min::vec3> box = drone_box(center);
 
             // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            collision_cells(out, box);
         }
     }
     inline void drop_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
@@ -957,7 +1297,7 @@ class cgrid
             const min::aabbox<float, min::vec3> box = drop_box(center);
 
             // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            collision_cells(out, box);
         }
     }
     inline void explosive_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
@@ -973,7 +1313,7 @@ class cgrid
             const min::aabbox<float, min::vec3> box = explode_box(center);
 
             // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            collision_cells(out, box);
         }
     }
     inline void missile_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
@@ -989,7 +1329,7 @@ class cgrid
             const min::aabbox<float, min::vec3> box = missile_box(center);
 
             // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            collision_cells(out, box);
         }
     }
     inline void player_collision_cells(std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> &out, const min::vec3<float> &center) const
@@ -1005,30 +1345,22 @@ class cgrid
             const min::aabbox<float, min::vec3> box = player_box(center);
 
             // Calculate collision cells around this box
-            collision_cells(out, box, center);
+            collision_cells(out, box);
         }
     }
     inline void flush_chunk_updates()
     {
-        // Sort chunk keys using a radix sort
-        min::uint_sort<size_t>(_chunk_update_keys, _sort_chunk, [](const size_t i) {
-            return i;
-        });
-
-        // Make keys unique
-        const auto last = std::unique(_chunk_update_keys.begin(), _chunk_update_keys.end());
-
-        // Erase empty spaces in vector
-        _chunk_update_keys.erase(last, _chunk_update_keys.end());
-
-        // Update all modified chunks
-        for (const auto k : _chunk_update_keys)
+        // Update all modified chunks, keys are already unique
+        for (const auto k : _chunk_dirty_keys)
         {
             chunk_update(k);
+
+            // Clear the dirty flag
+            _chunk_dirty[k] = false;
         }
 
         // Clear out chunk update keys
-        _chunk_update_keys.clear();
+        _chunk_dirty_keys.clear();
     }
     inline min::mesh<float, uint32_t> &get_chunk(const size_t key)
     {
@@ -1050,6 +1382,10 @@ class cgrid
     {
         return _world;
     }
+    inline const world_seed &get_world_seed() const
+    {
+        return _seed;
+    }
     inline bool is_viewable(const min::camera<float> &cam, const min::aabbox<float, min::vec3> &box) const
     {
         // Is the box inside the frustum?
@@ -1065,29 +1401,21 @@ class cgrid
 
         return false;
     }
-    inline unsigned load_swatch(swatch &sw, const min::vec3<float> &start, const min::vec3<int> &offset, const min::vec3<unsigned> &length) const
+    inline unsigned load_swatch(swatch &sw, const min::vec3<float> &start, const min::vec3<int> &offset, const min::vec3<unsigned> &length)
     {
-        // Swatch cost
-        unsigned out = 0;
-
-        // Load swatch offset and length
+        // Load swatch offset and length, drop old contents
+        sw.reset();
         sw.set_length(length);
         sw.set_offset(offset);
 
-        // Create cubic function, for each cell in cubic space
-        const auto f = [this, &sw, &out](const size_t i, const size_t j, const size_t k, const size_t key) {
-            // Get the atlas of this grid point
-            const block_id atlas = this->_grid[key];
-
-            // Load atlas into swatch
-            sw.set(i, j, k, atlas);
-
-            // Count ether cost
-            out += ether_cost(atlas);
+        // Function to get the swatch row for region row
+        const auto row = [&sw](const size_t i, const size_t j) -> block_id * {
+            return sw.write_row(i, j);
         };
 
-        // Run the function
-        cubic_grid(start, length, offset, f);
+        // Copy region rows into swatch and compress the pages
+        const unsigned out = region_store(make_region(start, length, offset), row);
+        sw.flush();
 
         // Return the swatch cost
         return out;
@@ -1133,10 +1461,11 @@ class cgrid
 
         // Calculate max edges
         const min::vec3<unsigned> &length = sw.get_length();
+        const min::vec3<int> &offset = sw.get_offset();
         const auto edges = std::make_tuple(length.x() - 1, length.y() - 1, length.z() - 1);
 
         // Function to retrieve block value
-        const auto get_block = [this, &sw](const std::tuple<size_t, size_t, size_t> &t) -> block_id {
+        const auto get_block = [&sw](const std::tuple<size_t, size_t, size_t> &t) -> block_id {
             // Get the block atlas
             const block_id atlas = sw.get(std::get<0>(t), std::get<1>(t), std::get<2>(t));
 
@@ -1144,28 +1473,57 @@ class cgrid
             return (atlas == block_id::EMPTY) ? block_id::CRYSTAL_P : atlas;
         };
 
-        // Create cubic function, for each cell in cubic space
-        const auto f = [this, &sw, &edges, &get_block](const size_t i, const size_t j, const size_t k, const size_t key) {
-            // Add data to mesher for each cell
-            const min::vec3<float> p = this->grid_cell(key);
+        // Store start point => (0,0,0),
+        // FOR ATLAS ONLY (0, 0, 0) IS THE CENTER!
+        // Different than grid because of translation matrix!
+        const min::vec3<float> start = min::vec3<float>().clamp(_world.get_min(), _world.get_max());
+        const auto t = min::vec3<float>::grid_index(_world.get_min(), _cell_extent, start);
+        const size_t end = _grid_scale;
 
-            // Pack the current index
-            const auto index = std::make_tuple(i, j, k);
+        // Mesh each x slice of the swatch into its own buffer
+        const auto work = [this, &length, &offset, &edges, &get_block, &t, end](std::mt19937 &gen, const size_t i) {
+            std::vector<min::vec4<float>> &cells = _preview_cells[i];
+            cells.clear();
+
+            // x axis: will prune points outside grid
+            const size_t tx = std::get<0>(t) + i * offset.x();
+            if (tx >= end)
+            {
+                return;
+            }
+
+            // y axis: will prune points outside grid
+            size_t ty = std::get<1>(t);
+            for (size_t j = 0; j < length.y() && ty < end; j++, ty += offset.y())
+            {
+                // z axis: will prune points outside grid
+                size_t tz = std::get<2>(t);
+                for (size_t k = 0; k < length.z() && tz < end; k++, tz += offset.z())
+                {
+                    // Add data to mesher for each cell
+                    const min::vec3<float> p = this->grid_cell(this->grid_key_pack(std::make_tuple(tx, ty, tz)));
 
-            // Convert atlas to a float
-            const float float_atlas = static_cast<float>(get_block(index));
+                    // Pack the current index
+                    const auto index = std::make_tuple(i, j, k);
 
-            // Mesh the cell
-            this->_mesher.generate_chunk_faces_rotated(p, sw.get_offset(), index, edges, get_block, float_atlas);
+                    // Convert atlas to a float
+                    const float float_atlas = static_cast<float>(get_block(index));
+
+                    // Mesh the cell
+                    terrain_mesher::generate_chunk_faces_rotated(cells, p, offset, index, edges, get_block, float_atlas);
+                }
+            }
         };
 
-        // Store start point => (0,0,0),
-        // FOR ATLAS ONLY (0, 0, 0) IS THE CENTER!
-        // Different than grid because of translation matrix!
-        min::vec3<float> start;
+        // Mesh slices in parallel
+        const size_t xn = std::min(static_cast<size_t>(length.x()), _preview_cells.size());
+        work_queue::worker.run(std::cref(work), 0, xn);
 
-        // Run the function
-        cubic_grid(start, sw.get_length(), sw.get_offset(), f);
+        // Gather the slices in order
+        for (size_t i = 0; i < xn; i++)
+        {
+            _mesher.append(_preview_cells[i]);
+        }
 
         // Generate mesh
         _mesher.generate_preview(mesh);
@@ -1230,79 +1588,58 @@ class cgrid
     }
     inline void portal()
     {
+        // Fence off the world and queue every chunk to be generated, the world file is no longer needed
+        _graph.reset();
+        page_reset();
+
+        // Generate a new world from a new seed, chunks near the player are generated first
+        _seed = world_seed(_generator.random_seed(), true);
         generate_portal();
 
-        // Update all chunks
+        // Every chunk needs saving
         const size_t chunks = _chunks.size();
         for (size_t i = 0; i < chunks; i++)
         {
-            chunk_update(i);
+            _chunk_gen[i]++;
         }
     }
-    inline void set_boundary_chunk(const size_t key)
+    inline void set_chunk_dirty(const size_t chunk_key)
     {
-        // Find out if we are on a chunk boundary
-        const auto g = grid_key_unpack(key);
-        const size_t gx = std::get<0>(g);
-        const size_t gy = std::get<1>(g);
-        const size_t gz = std::get<2>(g);
-
-        // Relative grid components in chunk
-        const size_t rgx = gx % _chunk_size;
-        const size_t rgy = gy % _chunk_size;
-        const size_t rgz = gz % _chunk_size;
+        // Chunk changed since the last save
+        _chunk_gen[chunk_key]++;
 
-        // Chunk index of grid index
-        const size_t cx = gx / _chunk_size;
-        const size_t cy = gy / _chunk_size;
-        const size_t cz = gz / _chunk_size;
-
-        // Convert chunk grid components to chunk index
-        const auto to_chunk_key = [this](const size_t x, const size_t y, const size_t z) -> size_t {
-            return (x * _chunk_scale * _chunk_scale) + (y * _chunk_scale) + (z);
-        };
-
-        // Chunk top edge
-        const size_t c_edge = _chunk_size - 1;
-
-        // World top edge
-        const size_t w_edge = _grid_scale - 1;
+        // Remesh the chunk
+        queue_chunk_update(chunk_key);
+    }
+    unsigned move_geometry(const min::vec3<float> &start, const min::vec3<unsigned> &length, const min::vec3<int> &offset, const min::vec3<float> &dest)
+    {
+        // Calculate source and destination regions
+        const grid_region src = make_region(start, length, offset);
+        const grid_region dst = make_region(dest, length, offset);
 
-        // Check x axis boundary
-        if (rgx == 0 && gx != 0)
+        // Only move boxes that fit inside the grid at both ends
+        const size_t xn = length.x();
+        const size_t yn = length.y();
+        const size_t zn = length.z();
+        const bool src_fit = src.count(0) == xn && src.count(1) == yn && src.count(2) == zn;
+        const bool dst_fit = dst.count(0) == xn && dst.count(1) == yn && dst.count(2) == zn;
+        if (!inside(start) || !inside(dest) || !src_fit || !dst_fit)
         {
-            const size_t ckey = to_chunk_key(cx - 1, cy, cz);
-            _chunk_update_keys.push_back(ckey);
-        }
-        else if (rgx % c_edge == 0 && gx != w_edge)
-        {
-            const size_t ckey = to_chunk_key(cx + 1, cy, cz);
-            _chunk_update_keys.push_back(ckey);
+            return 0;
         }
 
-        // Check y axis boundary
-        if (rgy == 0 && gy != 0)
-        {
-            const size_t ckey = to_chunk_key(cx, cy - 1, cz);
-            _chunk_update_keys.push_back(ckey);
-        }
-        else if (rgy % c_edge == 0 && gy != w_edge)
-        {
-            const size_t ckey = to_chunk_key(cx, cy + 1, cz);
-            _chunk_update_keys.push_back(ckey);
-        }
+        // Function to get the buffer row for region row
+        _region_buffer.resize(xn * yn * zn);
+        const auto row = [this, yn, zn](const size_t i, const size_t j) -> block_id * {
+            return &_region_buffer[(i * yn + j) * zn];
+        };
 
-        // Check z axis boundary
-        if (rgz == 0 && gz != 0)
-        {
-            const size_t ckey = to_chunk_key(cx, cy, cz - 1);
-            _chunk_update_keys.push_back(ckey);
-        }
-        else if (rgz % c_edge == 0 && gz != w_edge)
-        {
-            const size_t ckey = to_chunk_key(cx, cy, cz + 1);
-            _chunk_update_keys.push_back(ckey);
-        }
+        // Copy the source into the buffer, then clear the source
+        region_store(src, row);
+        region_clear(src, [](const min::vec3<float> &, const block_id) -> void {});
+
+        // Write the buffer into the destination, overwrites any blocks there
+        return region_load(dst, row);
     }
     unsigned set_geometry(const swatch &sw, const min::vec3<float> &start)
     {
@@ -1313,9 +1650,6 @@ class cgrid
         const min::vec3<unsigned> &length = sw.get_length();
         const min::vec3<int> &offset = sw.get_offset();
 
-        // Record all modified chunks and store them for updating
-        _chunk_update_keys.reserve(length.x() * length.y() * length.z());
-
         // If the start point is inside the grid
         const bool in = inside(start);
         if (in)
@@ -1333,15 +1667,12 @@ class cgrid
         // Modified geometry
         unsigned out = 0;
 
-        // Record all modified chunks and store them for updating
-        _chunk_update_keys.reserve(length.x() * length.y() * length.z());
-
         // If the start point is inside the grid
         const bool in = inside(start);
         if (atlas_id == block_id::EMPTY && in)
         {
             // Remove geometry
-            out += geometry_remove(start, length, offset, atlas_id, set_block_call);
+            out += geometry_remove(start, length, offset, set_block_call);
         }
         else if (in)
         {
@@ -1354,9 +1685,6 @@ class cgrid
     }
     min::vec3<float> set_geometry_box_3x3(const min::vec3<float> &p, const block_id atlas)
     {
-        // Record all modified chunks and store them for updating
-        _chunk_update_keys.reserve(18);
-
         // Get random position
         const min::vec3<float> snapped = snap(p);
         const float nx = snapped.x() - 1.0;
@@ -1373,7 +1701,7 @@ class cgrid
         };
 
         // Carve out inside of box
-        geometry_remove(start, length, offset, block_id::EMPTY, f);
+        geometry_remove(start, length, offset, f);
 
         // Create -XZ floor
         start.y(ny - 1.0);
@@ -1417,24 +1745,128 @@ class cgrid
     {
         return _chunk_update[chunk_key];
     }
-    inline void save()
+    inline void page_all()
     {
-        // Create output stream for saving world
-        std::vector<uint8_t> stream;
+        // If chunks are still waiting to be generated
+        const size_t size = _page_queue.size();
+        if (_page_head >= size)
+        {
+            return;
+        }
+
+        // Generate all remaining chunks in parallel
+        for (size_t i = _page_head; i < size; i++)
+        {
+            page_chunk(_page_queue[i]);
+        }
+        page_keys();
+    }
+    inline void page_chunks()
+    {
+        // If chunks are still waiting to be generated
+        const size_t size = _page_queue.size();
+        if (_page_head >= size)
+        {
+            return;
+        }
+
+        // Unpack recent chunk key to components
+        const size_t scale2 = _chunk_scale * _chunk_scale;
+        const size_t rx = _recent_chunk / scale2;
+        const size_t ry = (_recent_chunk / _chunk_scale) % _chunk_scale;
+        const size_t rz = _recent_chunk % _chunk_scale;
+
+        // Page chunks nearest to the player first
+        if (!_page_sorted)
+        {
+            const auto dist = [this, scale2, rx, ry, rz](const size_t key) -> size_t {
+                const size_t cx = key / scale2;
+                const size_t cy = (key / _chunk_scale) % _chunk_scale;
+                const size_t cz = key % _chunk_scale;
+                const size_t dx = (cx > rx) ? cx - rx : rx - cx;
+                const size_t dy = (cy > ry) ? cy - ry : ry - cy;
+                const size_t dz = (cz > rz) ? cz - rz : rz - cz;
+
+                return dx * dx + dy * dy + dz * dz;
+            };
+            std::sort(_page_queue.begin() + _page_head, _page_queue.end(), [&dist](const size_t a, const size_t b) {
+                return dist(a) < dist(b);
+            });
+            _page_sorted = true;
+        }
+
+        // Always page the view region around the player
+        const size_t lx = (rx > _view_half_width) ? rx - _view_half_width : 0;
+        const size_t ly = (ry > _view_half_width) ? ry - _view_half_width : 0;
+        const size_t lz = (rz > _view_half_width) ? rz - _view_half_width : 0;
+        const size_t hx = std::min(rx + _view_half_width, _chunk_scale - 1);
+        const size_t hy = std::min(ry + _view_half_width, _chunk_scale - 1);
+        const size_t hz = std::min(rz + _view_half_width, _chunk_scale - 1);
+        for (size_t cx = lx; cx <= hx; cx++)
+        {
+            for (size_t cy = ly; cy <= hy; cy++)
+            {
+                for (size_t cz = lz; cz <= hz; cz++)
+                {
+                    page_chunk((cx * scale2) + (cy * _chunk_scale) + cz);
+                }
+            }
+        }
+        page_keys();
 
-        // Reserve space for grid
-        stream.reserve(_grid.size() * sizeof(block_id));
+        // Page in a budget of the remaining chunks, nearest first
+        for (size_t i = _page_head; i < _page_queue.size() && _page_keys.size() < _page_budget; i++)
+        {
+            page_chunk(_page_queue[i]);
+        }
+        page_keys();
+    }
+    inline void page_column(const min::vec3<float> &p)
+    {
+        bool is_valid = true;
+        const size_t key = chunk_key_safe(p, is_valid);
 
-        // Write data into stream
-        min::write_le_vector<block_id>(stream, _grid);
+        // Page every chunk in the column under this point
+        if (is_valid && _page_head < _page_queue.size())
+        {
+            const size_t base = key - ((key / _chunk_scale) % _chunk_scale) * _chunk_scale;
+            for (size_t cy = 0; cy < _chunk_scale; cy++)
+            {
+                page_chunk(base + cy * _chunk_scale);
+            }
+            page_keys();
+        }
+    }
+    inline void page_spawn(const min::vec3<float> &p)
+    {
+        // Page chunks outward from the spawn point
+        update_current_chunk(p);
+        _page_sorted = false;
+        page_chunks();
 
-        // Write data to file
-        save_file("bin/world.bmesh", stream);
+        // Mesh the view region so the game can resume
+        flush_chunk_updates();
+    }
+    inline void save()
+    {
+        // Write chunks modified since the last save, chunks that aren't generated yet keep their saved records
+        _file.save(_grid, _generator.get_baseline(), _chunk_gen, _seed, _chunk_paged);
     }
     inline void update_chunk(const size_t chunk_key)
     {
         _chunk_update[chunk_key] = false;
     }
+    inline void update_flow(const min::vec3<float> &p)
+    {
+        bool is_valid = true;
+        const size_t key = grid_key_safe(p, is_valid);
+
+        // Recompute the flow field if the destination cell changed
+        if (is_valid)
+        {
+            _flow.update(_grid, key);
+        }
+    }
     inline void update_current_chunk(const min::vec3<float> &p)
     {
         bool is_valid = true;
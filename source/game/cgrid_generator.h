@@ -18,21 +18,27 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __CGRID_GENERATOR__
 #define __CGRID_GENERATOR__
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
+#include <game/chunk_baseline.h>
+#include <game/chunk_pipeline.h>
 #include <game/id.h>
 #include <game/memory_map.h>
+#include <game/portal_cache.h>
 #include <game/work_queue.h>
 #include <kernel/mandelbulb_asym.h>
 #include <kernel/mandelbulb_exp.h>
 #include <kernel/mandelbulb_sym.h>
 #include <kernel/terrain_base.h>
 #include <kernel/terrain_height.h>
+#include <memory>
 #include <min/serial.h>
 #include <min/strtoken.h>
 #include <min/vec3.h>
 #include <random>
-#include <sstream>
+#include <stdexcept>
 
 namespace game
 {
@@ -40,32 +46,27 @@ namespace game
 class cgrid_generator
 {
   private:
-    std::string _asym;
-    std::vector<std::pair<size_t, size_t>> _asym_lines;
-    std::string _exp;
-    std::vector<std::pair<size_t, size_t>> _exp_lines;
-    std::string _sym;
-    std::vector<std::pair<size_t, size_t>> _sym_lines;
-    std::vector<block_id> _back;
-    std::istringstream _ss;
-    std::string _line;
+#ifdef MGL_PORTAL_VERIFY
+    static constexpr bool _verify = true;
+#else
+    static constexpr bool _verify = false;
+#endif
+    static constexpr size_t _asym_stride = 12;
+    static constexpr size_t _exp_stride = 4;
+    static constexpr size_t _sym_stride = 4;
+    std::vector<int> _asym;
+    std::vector<int> _exp;
+    std::vector<int> _sym;
+    const size_t _scale;
+    const size_t _chunk_size;
+    chunk_baseline _base;
+    chunk_pipeline _pipeline;
+    portal_cache _cache;
+    std::vector<uint8_t> _cached;
+    portal_key _key;
+    bool _store;
     std::mt19937 _gen;
 
-    inline void clear_grid(std::vector<block_id> &grid)
-    {
-        // Parallelize on copying buffers
-        const auto work = [&grid](std::mt19937 &gen, const size_t i) {
-            grid[i] = block_id::EMPTY;
-        };
-
-        // Convert cells to mesh in parallel
-        work_queue::worker.run(std::cref(work), 0, grid.size());
-    }
-    inline void clear_stream(const std::string &str)
-    {
-        _ss.clear();
-        _ss.str(str);
-    }
     inline size_t count_grid(std::vector<block_id> &grid)
     {
         // Out variable
@@ -84,176 +85,251 @@ class cgrid_generator
         // Return count;
         return count;
     }
-    inline kernel::mandelbulb_asym load_mandelbulb_asym(std::mt19937 &gen)
+    inline kernel::mandelbulb_asym load_mandelbulb_asym(std::mt19937 &gen, portal_key &key) const
     {
-        // Load uniform distribution for sym
-        std::uniform_int_distribution<unsigned> dist(0, _asym_lines.size() - 1);
-        const unsigned index = dist(gen);
-
-        // Get the line index and get the line string
-        const auto &p = _asym_lines[index];
-        _line = _asym.substr(p.first, p.second);
-
-        // Clear and reset the stream with line data
-        clear_stream(_line);
+        // Load uniform distribution for asym
+        std::uniform_int_distribution<unsigned> dist(0, _asym.size() / _asym_stride - 1);
+        const int *const c = &_asym[dist(gen) * _asym_stride];
 
-        // Parse the string into four ints
-        int a, b, c, d, e, f, g, h, i, j, k, l;
-        _ss >> a >> b >> c >> d >> e >> f >> g >> h >> i >> j >> k >> l;
-
-        // Check for errors
-        if (_ss.fail())
+        // Coefficients identify this world in the portal cache
+        for (size_t i = 0; i < _asym_stride; i++)
         {
-            throw std::runtime_error("cgrid_generator: Invalid man_asym line '" + _line + "'");
+            key.add(c[i]);
         }
 
         // Load the asymmetrical mandelbulb
-        return kernel::mandelbulb_asym(a, b, c, d, e, f, g, h, i, j, k, l);
+        return kernel::mandelbulb_asym(c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7], c[8], c[9], c[10], c[11]);
     }
-    inline kernel::mandelbulb_exp load_mandelbulb_exp(std::mt19937 &gen)
+    inline kernel::mandelbulb_exp load_mandelbulb_exp(std::mt19937 &gen, portal_key &key) const
     {
         // Load uniform distribution for exp
-        std::uniform_int_distribution<unsigned> dist(0, _exp_lines.size() - 1);
-        const unsigned index = dist(gen);
-
-        // Get the line index and get the line string
-        const auto &p = _exp_lines[index];
-        _line = _exp.substr(p.first, p.second);
-
-        // Clear and reset the stream with line data
-        clear_stream(_line);
-
-        // Parse the string into four ints
-        int a, b, c, d;
-        _ss >> a >> b >> c >> d;
+        std::uniform_int_distribution<unsigned> dist(0, _exp.size() / _exp_stride - 1);
+        const int *const c = &_exp[dist(gen) * _exp_stride];
 
-        // Check for errors
-        if (_ss.fail())
+        // Coefficients identify this world in the portal cache
+        for (size_t i = 0; i < _exp_stride; i++)
         {
-            throw std::runtime_error("cgrid_generator: Invalid man_exp line '" + _line + "'");
+            key.add(c[i]);
         }
 
         // Load the exponential mandelbulb
-        return kernel::mandelbulb_exp(a, b, c, d);
+        return kernel::mandelbulb_exp(c[0], c[1], c[2], c[3]);
     }
-    inline kernel::mandelbulb_sym load_mandelbulb_sym(std::mt19937 &gen)
+    inline kernel::mandelbulb_sym load_mandelbulb_sym(std::mt19937 &gen, portal_key &key) const
     {
         // Load uniform distribution for sym
-        std::uniform_int_distribution<unsigned> dist(0, _sym_lines.size() - 1);
-        const unsigned index = dist(gen);
+        std::uniform_int_distribution<unsigned> dist(0, _sym.size() / _sym_stride - 1);
+        const int *const c = &_sym[dist(gen) * _sym_stride];
 
-        // Get the line index and get the line string
-        const auto &p = _sym_lines[index];
-        _line = _sym.substr(p.first, p.second);
-
-        // Clear and reset the stream with line data
-        clear_stream(_line);
+        // Coefficients identify this world in the portal cache
+        for (size_t i = 0; i < _sym_stride; i++)
+        {
+            key.add(c[i]);
+        }
 
-        // Parse the string into four ints
-        int a, b, c, d;
-        _ss >> a >> b >> c >> d;
+        // Load the symmetrical mandelbulb
+        return kernel::mandelbulb_sym(c[0], c[1], c[2], c[3]);
+    }
+    static inline std::vector<int> load_portal_table(const std::string &file_name, const size_t lines, const size_t stride)
+    {
+        // Load the portal file, only needed while parsing
+        const std::string data = memory_map::memory.get_file(file_name).to_string();
+        const std::vector<std::pair<size_t, size_t>> offsets = tools::read_lines(data, lines);
+
+        // Parse each line into a packed row of ints
+        std::vector<int> table;
+        table.reserve(offsets.size() * stride);
+        for (const auto &p : offsets)
+        {
+            const char *str = data.c_str() + p.first;
+            const char *const end = str + p.second;
+            for (size_t i = 0; i < stride; i++)
+            {
+                // Every value must be inside this line
+                char *next = nullptr;
+                const long value = std::strtol(str, &next, 10);
+                if (next == str || next > end)
+                {
+                    throw std::runtime_error("cgrid_generator: Invalid line '" + data.substr(p.first, p.second) + "' in '" + file_name + "'");
+                }
+                table.push_back(static_cast<int>(value));
+                str = next;
+            }
+        }
 
-        // Check for errors
-        if (_ss.fail())
+        // Check the file isn't empty
+        if (table.empty())
         {
-            throw std::runtime_error("cgrid_generator: Invalid man_sym line '" + _line + "'");
+            throw std::runtime_error("cgrid_generator: No portals in '" + file_name + "'");
         }
 
-        // Load the symmetrical mandelbulb
-        return kernel::mandelbulb_sym(a, b, c, d);
+        return table;
     }
-    inline void load_portal_strings()
+    inline void load_portal_tables()
     {
-        // Load the portal files
-        _asym = memory_map::memory.get_file("data/portals/man_asym.portal").to_string();
-        _asym_lines = tools::read_lines(_asym, 1001);
-        _exp = memory_map::memory.get_file("data/portals/man_exp.portal").to_string();
-        _exp_lines = tools::read_lines(_exp, 738);
-        _sym = memory_map::memory.get_file("data/portals/man_sym.portal").to_string();
-        _sym_lines = tools::read_lines(_sym, 1001);
+        // Parse the portal files once
+        _asym = load_portal_table("data/portals/man_asym.portal", 1001, _asym_stride);
+        _exp = load_portal_table("data/portals/man_exp.portal", 738, _exp_stride);
+        _sym = load_portal_table("data/portals/man_sym.portal", 1001, _sym_stride);
+    }
+
+    template <typename M, typename G>
+    inline void prepare_mandelbulb(std::vector<block_id> &grid, const M &m, const G &grid_cell_center)
+    {
+        if (_verify)
+        {
+            // Verifying compares against exhaustive evaluation, so the whole grid is generated up front
+            work_queue::worker.wake();
+            m.generate_adaptive(work_queue::worker, grid, _scale, _chunk_size, grid_cell_center, _verify);
+            _base.encode(grid);
+            _cache.store(_key, _base);
+            work_queue::worker.sleep();
+            return;
+        }
+
+        // Generate the world if it isn't cached
+        const bool cached = _cache.open(_key);
+        _store = !cached;
+
+        // Decode each chunk from the cache entry, regenerate the chunk if it is missing or bad
+        _pipeline.add([this, &grid, m, grid_cell_center, cached](const size_t x, const size_t y, const size_t z) {
+            const size_t key = _pipeline.key(x, y, z);
+            if (cached && _cache.load_chunk(key, grid, _base))
+            {
+                // The baseline already has the encoded chunk
+                _cached[key] = 1;
+            }
+            else
+            {
+                m.generate_chunk(grid, _scale, grid_cell_center, x, y, z, _chunk_size);
+            }
+        });
     }
 
   public:
-    cgrid_generator(const std::vector<block_id> &grid)
-        : _back(grid.size(), block_id::EMPTY),
+    cgrid_generator(const size_t scale, const size_t chunk_size)
+        : _scale(scale), _chunk_size(chunk_size), _base(scale, chunk_size), _pipeline(scale, chunk_size),
+          _cache(scale, chunk_size), _cached(_base.size(), 0), _key(0, scale, chunk_size), _store(false),
           _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
     {
-        // Load the portal strings
-        load_portal_strings();
+        // Load the portal coefficients
+        load_portal_tables();
     }
-    inline void copy(std::vector<block_id> &grid) const
+    inline const chunk_baseline &get_baseline() const
     {
-        // Parallelize on copying buffers
-        const auto work = [this, &grid](std::mt19937 &gen, const size_t i) {
-            grid[i] = _back[i];
-        };
-
-        // Convert cells to mesh in parallel
-        work_queue::worker.run(std::cref(work), 0, grid.size());
+        return _base;
     }
-    void generate_world(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size)
+    inline uint32_t random_seed()
     {
-        // Wake up the threads for processing
-        work_queue::worker.wake();
-
-        // Calculates perlin noise
-        kernel::terrain_base base(scale, chunk_size, 0, scale / 2);
-        base.generate(work_queue::worker, _back);
-
-        // Calculates a height map
-        kernel::terrain_height height(scale, scale / 2, scale - 1);
-        height.generate(work_queue::worker, _gen, _back);
+        return _gen();
+    }
+    inline void finish()
+    {
+        // Every chunk is generated, store the world if it is a new portal or the cache entry was bad
+        const bool bad = _cache.is_open() && !_cache.is_valid();
+        _cache.close();
+        if (_store || bad)
+        {
+            _cache.store(_key, _base);
+        }
 
-        // Copy data from back to front buffer
-        copy(grid);
+        // Release the stages
+        reset();
+    }
+    inline void generate_chunk(std::vector<block_id> &grid, const size_t chunk_key)
+    {
+        // Every stage of a chunk only writes that chunk, so chunks can be generated in parallel
+        _pipeline.run_chunk(chunk_key);
 
-        // Put the threads back to sleep
-        work_queue::worker.sleep();
+        // Keep the generated chunk as the baseline for saving, unless it was taken from the cache
+        if (!_cached[chunk_key])
+        {
+            chunk_codec codec;
+            _base.encode_chunk(codec, grid, chunk_key);
+        }
     }
     template <typename F, typename G>
-    void generate_portal(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size,
-                         const F &grid_key_unpack, const G &grid_cell_center)
+    void prepare_portal(std::vector<block_id> &grid, const F &grid_key_unpack, const G &grid_cell_center, const uint32_t seed)
     {
-        // Wake up the threads for processing
-        work_queue::worker.wake();
+        // Forget the last world
+        reset();
+
+        // The seed picks the generator and its coefficients
+        std::mt19937 gen(seed);
 
-        // Choose between terrain generators
+        // Choose between terrain generators, sampling only subdivides near the fractal surface
         std::uniform_int_distribution<int> choose(1, 3);
-        const int type = choose(_gen);
+        const int type = choose(gen);
+        _key = portal_key(type, _scale, _chunk_size);
         if (type == 1)
         {
-            // Clear out the old grid
-            clear_grid(grid);
-
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_sym(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
-            });
+            // Generate mandelbulb world using mandelbulb generator, unless it is cached
+            prepare_mandelbulb(grid, load_mandelbulb_sym(gen, _key), grid_cell_center);
         }
-        if (type == 2)
+        else if (type == 2)
         {
-            // Clear out the old grid
-            clear_grid(grid);
-
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_asym(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
-            });
+            // Generate mandelbulb world using mandelbulb generator, unless it is cached
+            prepare_mandelbulb(grid, load_mandelbulb_asym(gen, _key), grid_cell_center);
         }
         else
         {
-            // Clear out the old grid
-            clear_grid(grid);
-
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_exp(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
-            });
+            // Generate mandelbulb world using mandelbulb generator, unless it is cached
+            prepare_mandelbulb(grid, load_mandelbulb_exp(gen, _key), grid_cell_center);
         }
+    }
+    void prepare_world(std::vector<block_id> &grid, const uint32_t seed)
+    {
+        // Forget the last world
+        reset();
+
+        // Wake up the threads for processing
+        work_queue::worker.wake();
+
+        // Derive a seed for each stage from the world seed
+        std::mt19937 gen(seed);
+
+        // Perlin noise base and height map terrain, the height map and placements are made up front
+        const size_t scale = _scale;
+        const size_t chunk_size = _chunk_size;
+        const auto base = std::make_shared<const kernel::terrain_base>(scale, chunk_size, 0, scale / 2, gen());
+        const auto height = std::make_shared<const kernel::terrain_height>(work_queue::worker, scale, chunk_size, scale / 2, scale - 1, gen());
+
+        // Every stage of a chunk only writes that chunk
+        _pipeline.add([&grid, scale, chunk_size](const size_t x, const size_t y, const size_t z) {
+            // Clear the chunk a z row at a time, generation writes straight into the grid
+            for (size_t i = x; i < x + chunk_size; i++)
+            {
+                for (size_t j = y; j < y + chunk_size; j++)
+                {
+                    const size_t row = (i * scale + j) * scale + z;
+                    std::fill(grid.begin() + row, grid.begin() + row + chunk_size, block_id::EMPTY);
+                }
+            }
+        });
+        _pipeline.add([base, &grid](const size_t x, const size_t y, const size_t z) {
+            base->generate_chunk(grid, x, y, z);
+        });
+        _pipeline.add([height, &grid](const size_t x, const size_t y, const size_t z) {
+            height->generate_terrain(grid, x, y, z);
+        });
+        _pipeline.add([height, &grid](const size_t x, const size_t y, const size_t z) {
+            height->generate_trees(grid, x, y, z);
+        });
+        _pipeline.add([height, &grid](const size_t x, const size_t y, const size_t z) {
+            height->generate_plants(grid, x, y, z);
+        });
 
         // Put the threads back to sleep
         work_queue::worker.sleep();
     }
+    inline void reset()
+    {
+        // Release the cache entry and the stages of the last world
+        _cache.close();
+        _pipeline.clear();
+        std::fill(_cached.begin(), _cached.end(), 0);
+        _store = false;
+    }
 };
 }
 
@@ -0,0 +1,112 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __CHUNK_BASELINE__
+#define __CHUNK_BASELINE__
+
+#include <algorithm>
+#include <cstdint>
+#include <game/chunk_codec.h>
+#include <game/id.h>
+#include <game/work_queue.h>
+#include <vector>
+
+namespace game
+{
+
+class chunk_baseline
+{
+  private:
+    static constexpr size_t _batch = 64;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    std::vector<std::vector<uint8_t>> _encoded;
+
+  public:
+    chunk_baseline(const size_t grid_scale, const size_t chunk_size)
+        : _grid_scale(grid_scale), _chunk_size(chunk_size), _chunk_scale(grid_scale / chunk_size),
+          _encoded(_chunk_scale * _chunk_scale * _chunk_scale) {}
+
+    inline const std::vector<uint8_t> &chunk(const size_t chunk_key) const
+    {
+        return _encoded[chunk_key];
+    }
+    static inline size_t chunk_origin(const size_t grid_scale, const size_t chunk_size, const size_t chunk_key)
+    {
+        // Unpack chunk key to the grid key of the first cell
+        const size_t chunk_scale = grid_scale / chunk_size;
+        const size_t cx = chunk_key / (chunk_scale * chunk_scale);
+        const size_t cy = (chunk_key / chunk_scale) % chunk_scale;
+        const size_t cz = chunk_key % chunk_scale;
+
+        return (cx * grid_scale * grid_scale + cy * grid_scale + cz) * chunk_size;
+    }
+    inline void decode(const size_t chunk_key, std::vector<block_id> &out) const
+    {
+        // Function to get chunk rows, the chunk is unpacked into its own buffer
+        out.resize(_chunk_size * _chunk_size * _chunk_size);
+        const auto row = [this, &out](const size_t r) -> block_id * {
+            return &out[r * _chunk_size];
+        };
+
+        // The baseline is always a valid encoding
+        const std::vector<uint8_t> &src = _encoded[chunk_key];
+        chunk_codec::decode(src.data(), src.size(), row, _chunk_size * _chunk_size, _chunk_size);
+    }
+    inline void encode(const std::vector<block_id> &grid)
+    {
+        // Encode batches of chunks in parallel, one codec per batch
+        const size_t chunks = _encoded.size();
+        const size_t batches = (chunks + _batch - 1) / _batch;
+        const auto work = [this, &grid, chunks](std::mt19937 &, const size_t b) {
+            chunk_codec codec;
+            const size_t end = std::min((b + 1) * _batch, chunks);
+            for (size_t i = b * _batch; i < end; i++)
+            {
+                encode_chunk(codec, grid, i);
+            }
+        };
+        work_queue::worker.run(std::cref(work), 0, batches);
+    }
+    inline void encode_chunk(chunk_codec &codec, const std::vector<block_id> &grid, const size_t chunk_key)
+    {
+        // Function to get chunk rows, rows are contiguous along z
+        const size_t origin = chunk_origin(_grid_scale, _chunk_size, chunk_key);
+        const auto row = [this, &grid, origin](const size_t r) -> const block_id * {
+            const size_t x = r / _chunk_size;
+            const size_t y = r % _chunk_size;
+            return &grid[origin + (x * _grid_scale + y) * _grid_scale];
+        };
+
+        // Encode this chunk, keep the allocation for the next world
+        _encoded[chunk_key].clear();
+        codec.encode(_encoded[chunk_key], row, _chunk_size * _chunk_size, _chunk_size);
+    }
+    inline void set_chunk(const size_t chunk_key, const uint8_t *const src, const size_t size)
+    {
+        // Take an already encoded chunk
+        _encoded[chunk_key].assign(src, src + size);
+    }
+    inline size_t size() const
+    {
+        return _encoded.size();
+    }
+};
+}
+
+#endif
@@ -0,0 +1,317 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __CHUNK_CODEC__
+#define __CHUNK_CODEC__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <game/id.h>
+#include <vector>
+
+namespace game
+{
+
+class chunk_codec
+{
+  private:
+    static constexpr uint8_t _uniform = 0;
+    static constexpr uint8_t _run = 1;
+    static constexpr uint8_t _packed = 2;
+    std::array<uint8_t, 256> _lookup;
+    std::vector<block_id> _palette;
+    std::vector<uint8_t> _runs;
+
+    static inline uint8_t to_byte(const block_id id)
+    {
+        return static_cast<uint8_t>(static_cast<int8_t>(id));
+    }
+    static inline block_id to_id(const uint8_t b)
+    {
+        return static_cast<block_id>(static_cast<int8_t>(b));
+    }
+    static inline uint8_t index_bits(const size_t colors)
+    {
+        // Bits per cell are a power of two so cells never straddle bytes
+        if (colors <= 2)
+        {
+            return 1;
+        }
+        else if (colors <= 4)
+        {
+            return 2;
+        }
+        else if (colors <= 16)
+        {
+            return 4;
+        }
+
+        return 8;
+    }
+    static inline void write_varint(std::vector<uint8_t> &out, size_t value)
+    {
+        // Seven bits per byte, high bit flags more bytes
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+    static inline bool read_varint(const uint8_t *const src, const size_t size, size_t &next, size_t &value)
+    {
+        value = 0;
+        for (size_t shift = 0; next < size && shift < 64; shift += 7)
+        {
+            const uint8_t b = src[next++];
+            value |= static_cast<size_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+    template <typename R>
+    inline void build_palette(const R &row, const size_t rows, const size_t n)
+    {
+        // Collect the unique blocks in this chunk
+        _palette.clear();
+        _lookup.fill(0xFF);
+        for (size_t r = 0; r < rows; r++)
+        {
+            const block_id *const src = row(r);
+            for (size_t k = 0; k < n; k++)
+            {
+                const uint8_t b = to_byte(src[k]);
+                if (_lookup[b] == 0xFF)
+                {
+                    _lookup[b] = static_cast<uint8_t>(_palette.size());
+                    _palette.push_back(src[k]);
+                }
+            }
+        }
+    }
+    template <typename R>
+    inline void encode_runs(const R &row, const size_t rows, const size_t n)
+    {
+        // Run length code palette indices, runs continue across rows
+        _runs.clear();
+        uint8_t current = _lookup[to_byte(row(0)[0])];
+        size_t length = 0;
+        for (size_t r = 0; r < rows; r++)
+        {
+            const block_id *const src = row(r);
+            for (size_t k = 0; k < n; k++)
+            {
+                const uint8_t index = _lookup[to_byte(src[k])];
+                if (index != current)
+                {
+                    _runs.push_back(current);
+                    write_varint(_runs, length);
+                    current = index;
+                    length = 0;
+                }
+                length++;
+            }
+        }
+
+        // Write the last run
+        _runs.push_back(current);
+        write_varint(_runs, length);
+    }
+
+  public:
+    chunk_codec()
+    {
+        _lookup.fill(0xFF);
+        _palette.reserve(256);
+    }
+    template <typename R>
+    inline void encode(std::vector<uint8_t> &out, const R &row, const size_t rows, const size_t n)
+    {
+        // Find the blocks used in this chunk
+        build_palette(row, rows, n);
+
+        // Uniform chunks are a single block id
+        const size_t colors = _palette.size();
+        if (colors == 1)
+        {
+            const uint8_t mode = _uniform;
+            out.push_back(mode);
+            out.push_back(to_byte(_palette[0]));
+            return;
+        }
+
+        // Run length code the chunk
+        encode_runs(row, rows, n);
+
+        // Bit pack the chunk if runs are short
+        const uint8_t bits = index_bits(colors);
+        const size_t per = 8 / bits;
+        const size_t cells = rows * n;
+        const size_t packed_size = (cells + per - 1) / per;
+        const bool packed = packed_size + 1 < _runs.size();
+
+        // Write the palette
+        const uint8_t mode = packed ? _packed : _run;
+        out.push_back(mode);
+        out.push_back(static_cast<uint8_t>(colors - 1));
+        for (const block_id id : _palette)
+        {
+            out.push_back(to_byte(id));
+        }
+
+        if (packed)
+        {
+            // Pack palette indices into bytes
+            const size_t start = out.size();
+            out.resize(start + packed_size, 0);
+            size_t i = 0;
+            for (size_t r = 0; r < rows; r++)
+            {
+                const block_id *const src = row(r);
+                for (size_t k = 0; k < n; k++, i++)
+                {
+                    const uint8_t shift = (i % per) * bits;
+                    out[start + i / per] |= _lookup[to_byte(src[k])] << shift;
+                }
+            }
+        }
+        else
+        {
+            out.insert(out.end(), _runs.begin(), _runs.end());
+        }
+    }
+    template <typename R>
+    static inline bool decode(const uint8_t *const src, const size_t size, const R &row, const size_t rows, const size_t n)
+    {
+        if (size < 2)
+        {
+            return false;
+        }
+
+        // Uniform chunks are a single block id, INVALID cells keep their current value
+        const uint8_t mode = src[0];
+        if (mode == _uniform)
+        {
+            const block_id id = to_id(src[1]);
+            if (id != block_id::INVALID)
+            {
+                for (size_t r = 0; r < rows; r++)
+                {
+                    std::fill(row(r), row(r) + n, id);
+                }
+            }
+
+            return true;
+        }
+
+        // Read the palette
+        const size_t colors = static_cast<size_t>(src[1]) + 1;
+        size_t next = 2 + colors;
+        if (next > size)
+        {
+            return false;
+        }
+        const uint8_t *const palette = src + 2;
+
+        if (mode == _packed)
+        {
+            // Unpack palette indices from bytes
+            const uint8_t bits = index_bits(colors);
+            const size_t per = 8 / bits;
+            const uint8_t mask = (1 << bits) - 1;
+            if (next + (rows * n + per - 1) / per > size)
+            {
+                return false;
+            }
+
+            size_t i = 0;
+            for (size_t r = 0; r < rows; r++)
+            {
+                block_id *const dst = row(r);
+                for (size_t k = 0; k < n; k++, i++)
+                {
+                    const uint8_t shift = (i % per) * bits;
+                    const uint8_t index = (src[next + i / per] >> shift) & mask;
+                    if (index >= colors)
+                    {
+                        return false;
+                    }
+
+                    // Skip cells that keep their current value
+                    const block_id id = to_id(palette[index]);
+                    if (id != block_id::INVALID)
+                    {
+                        dst[k] = id;
+                    }
+                }
+            }
+
+            return true;
+        }
+        else if (mode == _run)
+        {
+            // Expand runs across rows
+            size_t r = 0;
+            size_t k = 0;
+            while (r < rows)
+            {
+                // Read the next run
+                if (next >= size)
+                {
+                    return false;
+                }
+                const uint8_t index = src[next++];
+                size_t length;
+                if (index >= colors || !read_varint(src, size, next, length))
+                {
+                    return false;
+                }
+
+                // Fill the run a row segment at a time
+                const block_id id = to_id(palette[index]);
+                while (length > 0 && r < rows)
+                {
+                    const size_t count = std::min(length, n - k);
+                    if (id != block_id::INVALID)
+                    {
+                        block_id *const dst = row(r);
+                        std::fill(dst + k, dst + k + count, id);
+                    }
+                    length -= count;
+                    k += count;
+                    if (k == n)
+                    {
+                        k = 0;
+                        r++;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        return false;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,483 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __CHUNK_GRAPH__
+#define __CHUNK_GRAPH__
+
+#include <algorithm>
+#include <cstdint>
+#include <game/id.h>
+#include <limits>
+#include <vector>
+
+namespace game
+{
+
+class chunk_link
+{
+  private:
+    size_t _key;
+    size_t _nkey;
+    size_t _dist;
+    uint8_t _comp;
+    uint8_t _ncomp;
+
+  public:
+    chunk_link(const uint8_t comp, const uint8_t ncomp, const size_t key, const size_t nkey, const size_t dist)
+        : _key(key), _nkey(nkey), _dist(dist), _comp(comp), _ncomp(ncomp) {}
+
+    inline uint8_t comp() const
+    {
+        return _comp;
+    }
+    inline size_t dist() const
+    {
+        return _dist;
+    }
+    inline size_t key() const
+    {
+        return _key;
+    }
+    inline uint8_t ncomp() const
+    {
+        return _ncomp;
+    }
+    inline size_t nkey() const
+    {
+        return _nkey;
+    }
+};
+
+class chunk_graph
+{
+  private:
+    static constexpr uint8_t _comp_limit = 32;
+    static constexpr uint8_t _no_comp = std::numeric_limits<uint8_t>::max();
+    static constexpr size_t _search_budget = 4096;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    std::vector<uint8_t> _label;
+    std::vector<std::vector<chunk_link>> _links;
+    std::vector<size_t> _stack;
+    std::vector<size_t> _fill;
+    std::vector<std::pair<size_t, size_t>> _comps;
+    std::vector<uint32_t> _visit;
+    std::vector<uint32_t> _parent;
+    std::vector<uint32_t> _queue;
+    uint32_t _gen;
+
+    inline size_t center_dist(const size_t i) const
+    {
+        // Distance from the face center, in half cells
+        const size_t twice = 2 * i;
+        const size_t edge = _chunk_size - 1;
+        return (twice > edge) ? twice - edge : edge - twice;
+    }
+    inline size_t chunk_key(const size_t x, const size_t y, const size_t z) const
+    {
+        return (x * _chunk_scale * _chunk_scale) + (y * _chunk_scale) + z;
+    }
+    inline size_t chunk_of(const size_t key) const
+    {
+        // Unpack grid key into chunk components
+        const size_t scale2 = _grid_scale * _grid_scale;
+        const size_t x = (key / scale2) / _chunk_size;
+        const size_t y = ((key / _grid_scale) % _grid_scale) / _chunk_size;
+        const size_t z = (key % _grid_scale) / _chunk_size;
+
+        return chunk_key(x, y, z);
+    }
+    inline size_t grid_key(const size_t x, const size_t y, const size_t z) const
+    {
+        return (x * _grid_scale * _grid_scale) + (y * _grid_scale) + z;
+    }
+    inline bool neighbor(const size_t ckey, const size_t face, size_t &nkey) const
+    {
+        // Unpack chunk key to components
+        const size_t scale2 = _chunk_scale * _chunk_scale;
+        size_t c[3] = {ckey / scale2, (ckey / _chunk_scale) % _chunk_scale, ckey % _chunk_scale};
+
+        // Faces are ordered -x, +x, -y, +y, -z, +z
+        const size_t axis = face / 2;
+        if (face % 2 == 0)
+        {
+            if (c[axis] == 0)
+            {
+                return false;
+            }
+            c[axis]--;
+        }
+        else
+        {
+            if (c[axis] == _chunk_scale - 1)
+            {
+                return false;
+            }
+            c[axis]++;
+        }
+
+        nkey = chunk_key(c[0], c[1], c[2]);
+        return true;
+    }
+    inline uint32_t node(const size_t ckey, const uint8_t comp) const
+    {
+        return static_cast<uint32_t>(ckey * _comp_limit + comp);
+    }
+    inline void label_chunk(const size_t ckey, const std::vector<block_id> &grid)
+    {
+        // Unpack chunk start cell
+        const size_t scale2 = _chunk_scale * _chunk_scale;
+        const size_t sx = (ckey / scale2) * _chunk_size;
+        const size_t sy = ((ckey / _chunk_scale) % _chunk_scale) * _chunk_size;
+        const size_t sz = (ckey % _chunk_scale) * _chunk_size;
+        const size_t ex = sx + _chunk_size;
+        const size_t ey = sy + _chunk_size;
+        const size_t ez = sz + _chunk_size;
+
+        // Clear all labels in the chunk
+        for (size_t x = sx; x < ex; x++)
+        {
+            for (size_t y = sy; y < ey; y++)
+            {
+                const size_t row = grid_key(x, y, sz);
+                std::fill(&_label[row], &_label[row] + _chunk_size, _no_comp);
+            }
+        }
+
+        // Flood fill each empty region, record first cell and region size
+        _comps.clear();
+        _fill.clear();
+        for (size_t x = sx; x < ex; x++)
+        {
+            for (size_t y = sy; y < ey; y++)
+            {
+                for (size_t z = sz; z < ez; z++)
+                {
+                    const size_t key = grid_key(x, y, z);
+                    if (grid[key] == block_id::EMPTY && _label[key] == _no_comp)
+                    {
+                        const size_t begin = _fill.size();
+                        flood(key, sx, sy, sz, grid);
+                        _comps.emplace_back(begin, _fill.size() - begin);
+                    }
+                }
+            }
+        }
+
+        // Keep only the largest regions as graph nodes, small pockets stay unlabeled
+        if (_comps.size() > _comp_limit)
+        {
+            std::sort(_comps.begin(), _comps.end(), [](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+                return a.second > b.second;
+            });
+            _comps.resize(_comp_limit);
+        }
+
+        // Assign the final labels
+        std::vector<size_t>::const_iterator begin = _fill.begin();
+        for (const auto &f : _comps)
+        {
+            // Stamp all cells in the region
+            const uint8_t comp = static_cast<uint8_t>(&f - &_comps[0]);
+            const auto first = begin + f.first;
+            std::for_each(first, first + f.second, [this, comp](const size_t key) {
+                _label[key] = comp;
+            });
+        }
+
+        // Unstamp pockets that were dropped
+        for (const size_t key : _fill)
+        {
+            if (_label[key] >= _comp_limit)
+            {
+                _label[key] = _no_comp;
+            }
+        }
+    }
+    inline void flood(const size_t seed, const size_t sx, const size_t sy, const size_t sz, const std::vector<block_id> &grid)
+    {
+        // Temporarily stamp the region as visited
+        const uint8_t visited = _comp_limit;
+
+        // Push the seed
+        _stack.clear();
+        _stack.push_back(seed);
+        _label[seed] = visited;
+
+        // Iteratively fill the region inside the chunk
+        const size_t scale2 = _grid_scale * _grid_scale;
+        while (!_stack.empty())
+        {
+            const size_t key = _stack.back();
+            _stack.pop_back();
+            _fill.push_back(key);
+
+            // Chunk relative components
+            const size_t rx = key / scale2 - sx;
+            const size_t ry = (key / _grid_scale) % _grid_scale - sy;
+            const size_t rz = key % _grid_scale - sz;
+            const size_t edge = _chunk_size - 1;
+
+            // Function to push a neighbor cell
+            const auto push = [this, &grid, visited](const size_t n) {
+                if (grid[n] == block_id::EMPTY && _label[n] == _no_comp)
+                {
+                    _label[n] = visited;
+                    _stack.push_back(n);
+                }
+            };
+
+            // Only flood inside this chunk
+            if (rx != 0)
+            {
+                push(key - scale2);
+            }
+            if (rx != edge)
+            {
+                push(key + scale2);
+            }
+            if (ry != 0)
+            {
+                push(key - _grid_scale);
+            }
+            if (ry != edge)
+            {
+                push(key + _grid_scale);
+            }
+            if (rz != 0)
+            {
+                push(key - 1);
+            }
+            if (rz != edge)
+            {
+                push(key + 1);
+            }
+        }
+    }
+    inline void link_face(const size_t ckey, const size_t face)
+    {
+        // Clear the old links on this face
+        std::vector<chunk_link> &links = _links[ckey * 6 + face];
+        links.clear();
+
+        // If this face is on the world boundary
+        size_t nkey;
+        if (!neighbor(ckey, face, nkey))
+        {
+            return;
+        }
+
+        // Unpack chunk start cell
+        const size_t scale2 = _chunk_scale * _chunk_scale;
+        size_t s[3] = {(ckey / scale2) * _chunk_size, ((ckey / _chunk_scale) % _chunk_scale) * _chunk_size, (ckey % _chunk_scale) * _chunk_size};
+
+        // Fix the face axis to the boundary layer
+        const size_t axis = face / 2;
+        const size_t u = (axis + 1) % 3;
+        const size_t v = (axis + 2) % 3;
+        const bool positive = face % 2 == 1;
+        const size_t layer = positive ? s[axis] + _chunk_size - 1 : s[axis];
+        const size_t stride = (axis == 0) ? _grid_scale * _grid_scale : (axis == 1) ? _grid_scale : 1;
+
+        // Scan every cell pair across the face
+        size_t c[3];
+        c[axis] = layer;
+        for (size_t i = 0; i < _chunk_size; i++)
+        {
+            c[u] = s[u] + i;
+            for (size_t j = 0; j < _chunk_size; j++)
+            {
+                c[v] = s[v] + j;
+
+                // Both cells must be labeled regions
+                const size_t key = grid_key(c[0], c[1], c[2]);
+                const size_t nk = positive ? key + stride : key - stride;
+                const uint8_t comp = _label[key];
+                const uint8_t ncomp = _label[nk];
+                if (comp == _no_comp || ncomp == _no_comp)
+                {
+                    continue;
+                }
+
+                // Only store one portal per region pair, prefer the center of the face
+                const size_t dist = center_dist(i) + center_dist(j);
+                const auto same = [comp, ncomp](const chunk_link &l) -> bool {
+                    return l.comp() == comp && l.ncomp() == ncomp;
+                };
+                const auto it = std::find_if(links.begin(), links.end(), same);
+                if (it == links.end())
+                {
+                    links.emplace_back(comp, ncomp, key, nk, dist);
+                }
+                else if (dist < it->dist())
+                {
+                    *it = chunk_link(comp, ncomp, key, nk, dist);
+                }
+            }
+        }
+    }
+    inline void next_generation()
+    {
+        // Only pay for a full clear when the stamps wrap around
+        if (++_gen == 0)
+        {
+            std::fill(_visit.begin(), _visit.end(), 0);
+            _gen = 1;
+        }
+    }
+
+  public:
+    chunk_graph(const size_t grid_scale, const size_t chunk_size)
+        : _grid_scale(grid_scale), _chunk_size(chunk_size), _chunk_scale(grid_scale / chunk_size),
+          _label(grid_scale * grid_scale * grid_scale, _no_comp),
+          _links(_chunk_scale * _chunk_scale * _chunk_scale * 6),
+          _visit(_chunk_scale * _chunk_scale * _chunk_scale * _comp_limit, 0),
+          _parent(_visit.size(), 0), _gen(0)
+    {
+        // Reserve scratch memory
+        const size_t chunk_cells = chunk_size * chunk_size * chunk_size;
+        _stack.reserve(chunk_cells);
+        _fill.reserve(chunk_cells);
+        _comps.reserve(chunk_cells);
+        _queue.reserve(_search_budget);
+    }
+    inline void reset()
+    {
+        // Clear all labels and links
+        std::fill(_label.begin(), _label.end(), _no_comp);
+        for (auto &links : _links)
+        {
+            links.clear();
+        }
+    }
+    inline bool next_portal(const size_t start_key, const size_t stop_key, size_t &portal_key)
+    {
+        // Find graph nodes of the end points
+        const size_t start_chunk = chunk_of(start_key);
+        const size_t stop_chunk = chunk_of(stop_key);
+        const uint8_t start_comp = _label[start_key];
+        const uint8_t stop_comp = _label[stop_key];
+
+        // Can't route from or to unlabeled cells
+        if (start_comp == _no_comp || stop_comp == _no_comp)
+        {
+            return false;
+        }
+
+        // Already in the same region
+        const uint32_t start_node = node(start_chunk, start_comp);
+        const uint32_t stop_node = node(stop_chunk, stop_comp);
+        if (start_node == stop_node)
+        {
+            return false;
+        }
+
+        // Breadth first search over chunk regions
+        next_generation();
+        _queue.clear();
+        _queue.push_back(start_node);
+        _visit[start_node] = _gen;
+        bool found = false;
+        for (size_t head = 0; head < _queue.size() && !found; head++)
+        {
+            // Unpack the node
+            const uint32_t n = _queue[head];
+            const size_t ckey = n / _comp_limit;
+            const uint8_t comp = n % _comp_limit;
+
+            // Expand all portals leaving this region
+            for (size_t face = 0; face < 6; face++)
+            {
+                size_t nkey;
+                if (!neighbor(ckey, face, nkey))
+                {
+                    continue;
+                }
+
+                for (const chunk_link &l : _links[ckey * 6 + face])
+                {
+                    const uint32_t next = node(nkey, l.ncomp());
+                    if (l.comp() == comp && _visit[next] != _gen && _queue.size() < _search_budget)
+                    {
+                        _visit[next] = _gen;
+                        _parent[next] = n;
+                        _queue.push_back(next);
+                        if (next == stop_node)
+                        {
+                            found = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        // No route in budget
+        if (!found)
+        {
+            return false;
+        }
+
+        // Walk back to the first hop out of the start region
+        uint32_t hop = stop_node;
+        while (_parent[hop] != start_node)
+        {
+            hop = _parent[hop];
+        }
+
+        // Find the portal into the first hop
+        const size_t hop_chunk = hop / _comp_limit;
+        const uint8_t hop_comp = hop % _comp_limit;
+        for (size_t face = 0; face < 6; face++)
+        {
+            size_t nkey;
+            if (neighbor(start_chunk, face, nkey) && nkey == hop_chunk)
+            {
+                for (const chunk_link &l : _links[start_chunk * 6 + face])
+                {
+                    if (l.comp() == start_comp && l.ncomp() == hop_comp)
+                    {
+                        portal_key = l.nkey();
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+    inline void update(const size_t ckey, const std::vector<block_id> &grid)
+    {
+        // Relabel the regions in this chunk
+        label_chunk(ckey, grid);
+
+        // Relink this chunk and the facing side of all neighbors
+        for (size_t face = 0; face < 6; face++)
+        {
+            link_face(ckey, face);
+
+            size_t nkey;
+            if (neighbor(ckey, face, nkey))
+            {
+                link_face(nkey, face ^ 1);
+            }
+        }
+    }
+};
+}
+
+#endif
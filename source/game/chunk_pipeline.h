@@ -0,0 +1,97 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __CHUNK_PIPELINE__
+#define __CHUNK_PIPELINE__
+
+#include <cstdint>
+#include <functional>
+#include <game/thread_pool.h>
+#include <vector>
+
+namespace game
+{
+
+class chunk_pipeline
+{
+  public:
+    // Stages get the grid cell at the chunk origin and may only write cells inside that chunk
+    typedef std::function<void(const size_t, const size_t, const size_t)> stage;
+
+  private:
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    std::vector<stage> _stages;
+
+  public:
+    chunk_pipeline(const size_t grid_scale, const size_t chunk_size)
+        : _grid_scale(grid_scale), _chunk_size(chunk_size), _chunk_scale(grid_scale / chunk_size) {}
+
+    inline void add(const stage &s)
+    {
+        _stages.push_back(s);
+    }
+    inline size_t chunks() const
+    {
+        return _chunk_scale * _chunk_scale * _chunk_scale;
+    }
+    static inline uint32_t mix(const uint32_t seed, const size_t key)
+    {
+        // Hash the seed and a key so every chunk has its own random stream
+        uint64_t h = (static_cast<uint64_t>(seed) << 32) ^ key;
+        h += 0x9E3779B97F4A7C15;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EB;
+        h = h ^ (h >> 31);
+
+        return static_cast<uint32_t>(h >> 32);
+    }
+    inline void clear()
+    {
+        _stages.clear();
+    }
+    inline size_t key(const size_t x, const size_t y, const size_t z) const
+    {
+        // Pack the grid cell at the chunk origin to a chunk key
+        return ((x / _chunk_size) * _chunk_scale + (y / _chunk_size)) * _chunk_scale + (z / _chunk_size);
+    }
+    inline void run(thread_pool &pool) const
+    {
+        // Create working function, every stage of a chunk runs back to back while it is in cache
+        const auto work = [this](std::mt19937 &, const size_t chunk_key) {
+            run_chunk(chunk_key);
+        };
+
+        // Chunks never write each other, so they run in any order
+        pool.run(std::cref(work), 0, chunks());
+    }
+    inline void run_chunk(const size_t chunk_key) const
+    {
+        // Unpack chunk key to the grid cell at the chunk origin
+        const size_t x = (chunk_key / (_chunk_scale * _chunk_scale)) * _chunk_size;
+        const size_t y = ((chunk_key / _chunk_scale) % _chunk_scale) * _chunk_size;
+        const size_t z = (chunk_key % _chunk_scale) * _chunk_size;
+        for (const stage &s : _stages)
+        {
+            s(x, y, z);
+        }
+    }
+};
+}
+
+#endif
@@ -128,6 +128,7 @@ class controls
         keyboard.add(min::window::key_code::TAB);
         keyboard.add(min::window::key_code::LSHIFT);
         keyboard.add(min::window::key_code::KEYQ);
+        keyboard.add(min::window::key_code::KEYV);
 
         // Register callback function F1
         keyboard.register_keydown(min::window::key_code::F1, controls::toggle_text, (void *)this);
@@ -215,6 +216,9 @@ class controls
 
         // Register callback function KEYQ
         keyboard.register_keydown(min::window::key_code::KEYQ, controls::drop_item, (void *)this);
+
+        // Register callback function KEYV
+        keyboard.register_keydown(min::window::key_code::KEYV, controls::prev_swatch, (void *)this);
     }
     static void toggle_text(void *ptr, double step)
     {
@@ -699,6 +703,24 @@ class controls
         // Increase x scale
         world->set_scale_z(1);
     }
+    static void prev_swatch(void *ptr, double step)
+    {
+        // Get the state pointer
+        controls *const control = reinterpret_cast<controls *>(ptr);
+        state *const state = control->get_state();
+
+        // Early exit if paused
+        if (state->get_pause())
+        {
+            return;
+        }
+
+        // Get the world pointer
+        world *const world = control->get_world();
+
+        // Recall previous swatch
+        world->prev_swatch();
+    }
     static void reset(void *ptr, double step)
     {
         // Get the state pointer
@@ -18,6 +18,8 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __DRONES__
 #define __DRONES__
 
+#include <chrono>
+#include <deque>
 #include <game/callback.h>
 #include <game/cgrid.h>
 #include <game/id.h>
@@ -127,9 +129,9 @@ class drone
     {
         _launch = frames;
     }
-    inline min::vec3<float> step(cgrid &grid, const float speed)
+    inline min::vec3<float> step(const float speed)
     {
-        return get_path().step(grid) * speed;
+        return get_path().step() * speed;
     }
 };
 
@@ -140,14 +142,17 @@ class drones
     static constexpr uint_fast16_t _missile_level = 5;
     static constexpr uint_fast16_t _splash_level = 10;
     static constexpr uint_fast16_t _tunnel_level = 15;
+    static constexpr long _path_budget_us = 250;
     physics *const _sim;
     static_instance *const _inst;
     sound *const _sound;
     std::vector<std::pair<min::aabbox<float, min::vec3>, block_id>> _col_cells;
     min::vec3<float> _dest;
     std::vector<path> _paths;
+    std::deque<size_t> _path_queue;
     std::vector<drone> _drones;
     size_t _path_old;
+    std::chrono::steady_clock::duration _path_spent;
     coll_call _f;
     bool _disable;
     const std::string _str;
@@ -193,6 +198,27 @@ class drones
         // Apply force to the body per mass
         b.add_force(f * b.get_mass());
     }
+    inline void path_requests(cgrid &grid)
+    {
+        // Service path requests oldest first, physics substeps share the budget of the frame
+        const std::chrono::microseconds budget(static_cast<std::chrono::microseconds::rep>(_path_budget_us));
+        while (!_path_queue.empty() && _path_spent < budget)
+        {
+            // Pop the oldest request
+            const auto start = std::chrono::steady_clock::now();
+            path &pt = _paths[_path_queue.front()];
+            _path_queue.pop_front();
+
+            // Skip requests for paths that died or were already serviced
+            if (!pt.is_dead() && pt.is_pending())
+            {
+                pt.search(grid);
+            }
+
+            // The first request of a frame is always serviced, it may overshoot the budget
+            _path_spent += std::chrono::steady_clock::now() - start;
+        }
+    }
     inline static float path_speed(const float remain)
     {
         // Calculate speed slowing down as approaching goal
@@ -233,7 +259,7 @@ class drones
     drones(physics &sim, static_instance &inst, sound &s)
         : _sim(&sim), _inst(&inst), _sound(&s),
           _paths(static_instance::max_drones()), _path_old(0),
-          _f(nullptr), _disable(false), _str("Drone")
+          _path_spent(std::chrono::steady_clock::duration::zero()), _f(nullptr), _disable(false), _str("Drone")
     {
         reserve_memory();
     }
@@ -263,9 +289,17 @@ class drones
         // Reset the oldest path
         _path_old = 0;
 
+        // Drop all queued path requests
+        _path_queue.clear();
+
         // Reset disable flag
         _disable = false;
     }
+    inline void reset_path_budget()
+    {
+        // Called once per rendered frame before the physics substeps
+        _path_spent = std::chrono::steady_clock::duration::zero();
+    }
     inline bool damage(const size_t index, const min::vec3<float> &dir, const float dam)
     {
         // Get the drone
@@ -365,6 +399,26 @@ class drones
         // Update drone paths
         if (!_disable)
         {
+            // Share one flow field toward the destination for all drones
+            if (size > 0)
+            {
+                grid.update_flow(_dest);
+            }
+
+            // Queue path requests for drones without a path
+            for (size_t i = 0; i < size; i++)
+            {
+                path &pt = _drones[i].get_path();
+                if (!_drones[i].is_idle() && pt.need_path())
+                {
+                    pt.set_pending();
+                    _path_queue.push_back(_drones[i].path_id());
+                }
+            }
+
+            // Compute queued paths within the frame budget
+            path_requests(grid);
+
             for (size_t i = 0; i < size; i++)
             {
                 // Get the drone
@@ -376,8 +430,8 @@ class drones
                     // Get remaining distance
                     const float remain = d.get_path().get_remain();
 
-                    // Calculate the speed of the next step
-                    const min::vec3<float> step = d.step(grid, path_speed(remain));
+                    // Calculate the speed of the next step, coasts if path is queued
+                    const min::vec3<float> step = d.step(path_speed(remain));
 
                     // Add velocity to the body
                     body(i).set_linear_velocity(step);
@@ -426,6 +480,7 @@ class drones
 
             // Collision flag
             bool hit = false;
+            block_id atlas = block_id::EMPTY;
 
             // Solve static collisions
             const size_t body = d.body_id();
@@ -436,6 +491,12 @@ class drones
 
                 // Register hit flag, BUG FIX, DONT COLLAPSE THIS LINE!
                 hit = hit || status;
+
+                // Remember the block that was hit, sodium takes precedence
+                if (status && (atlas == block_id::EMPTY || cell.second == block_id::SODIUM))
+                {
+                    atlas = cell.second;
+                }
             }
 
             // If we got a hit
@@ -449,8 +510,8 @@ class drones
                     // Blow up geometry around drone
                     const min::vec3<unsigned> scale(3, 3, 3);
 
-                    // First collision, _col_cells must have a size if hit
-                    ex_scale_call(p, scale, _col_cells[0].second);
+                    // Explode with the block that was hit
+                    ex_scale_call(p, scale, atlas);
                 }
 
                 // Create new path
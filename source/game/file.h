@@ -26,6 +26,20 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 namespace game
 {
 
+void append_file(const std::string &file_name, const std::vector<uint8_t> &stream)
+{
+    // Append bytes to end of file
+    std::ofstream file(file_name, std::ios::out | std::ios::binary | std::ios::app);
+    if (file.is_open())
+    {
+        file.write(reinterpret_cast<const char *>(&stream[0]), stream.size());
+        file.close();
+    }
+    else
+    {
+        std::cout << "file: could not append file '" << file_name << "'" << std::endl;
+    }
+}
 void erase_file(const std::string &file_name)
 {
     // Erase file
@@ -63,6 +77,53 @@ void load_file(const std::string &file_name, std::vector<uint8_t> &stream)
         std::cout << "file: could not load file '" << file_name << "'" << std::endl;
     }
 }
+void recover_file(const std::string &file_name)
+{
+    // A replace that failed after removing the old file leaves only the complete temporary file
+    const std::string temp_name = file_name + ".tmp";
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    std::ifstream temp(temp_name, std::ios::in | std::ios::binary);
+    if (!file.is_open() && temp.is_open())
+    {
+        temp.close();
+        if (std::rename(temp_name.c_str(), file_name.c_str()) == 0)
+        {
+            std::cout << "file: recovered file '" << file_name << "'" << std::endl;
+        }
+    }
+}
+void replace_file(const std::string &file_name, const std::vector<uint8_t> &stream)
+{
+    // Write to a temporary file so a crash never leaves a partial save
+    const std::string temp_name = file_name + ".tmp";
+    std::ofstream file(temp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "file: could not save file '" << temp_name << "'" << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&stream[0]), stream.size());
+    file.close();
+
+    // A short write must never replace the old file
+    if (!file)
+    {
+        std::cout << "file: could not write file '" << temp_name << "'" << std::endl;
+        std::remove(temp_name.c_str());
+        return;
+    }
+
+    // Swap in the new file, some platforms can't rename over an existing file
+    if (std::rename(temp_name.c_str(), file_name.c_str()) != 0)
+    {
+        std::remove(file_name.c_str());
+        if (std::rename(temp_name.c_str(), file_name.c_str()) != 0)
+        {
+            // Keep the temporary file, it is recovered on the next load
+            std::cout << "file: could not replace file '" << file_name << "', kept '" << temp_name << "'" << std::endl;
+        }
+    }
+}
 void save_file(const std::string &file_name, const std::vector<uint8_t> &stream)
 {
     // Save bytes to file
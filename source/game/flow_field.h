@@ -0,0 +1,239 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __FLOW_FIELD__
+#define __FLOW_FIELD__
+
+#include <algorithm>
+#include <cstdint>
+#include <game/id.h>
+#include <vector>
+
+namespace game
+{
+
+class flow_field
+{
+  private:
+    static constexpr uint8_t _target = 6;
+    static constexpr uint8_t _unreached = 7;
+    const size_t _grid_scale;
+    const size_t _width;
+    std::vector<uint8_t> _dir;
+    std::vector<uint32_t> _queue;
+    size_t _ox;
+    size_t _oy;
+    size_t _oz;
+    size_t _sx;
+    size_t _sy;
+    size_t _sz;
+    size_t _target_key;
+    bool _dirty;
+
+    inline void bounds(const size_t c, size_t &origin, size_t &size) const
+    {
+        // Center the region on the target, clamp to grid
+        const size_t half = _width / 2;
+        origin = (c > half) ? c - half : 0;
+        size = std::min(_width, _grid_scale - origin);
+    }
+    inline size_t global_key(const size_t lx, const size_t ly, const size_t lz) const
+    {
+        return ((lx + _ox) * _grid_scale * _grid_scale) + ((ly + _oy) * _grid_scale) + (lz + _oz);
+    }
+    inline bool local_index(const size_t key, size_t &index) const
+    {
+        // Unpack key to components
+        const size_t x = key / (_grid_scale * _grid_scale);
+        const size_t y = (key / _grid_scale) % _grid_scale;
+        const size_t z = key % _grid_scale;
+
+        // Check the key is inside the region
+        if (x < _ox || y < _oy || z < _oz || x >= _ox + _sx || y >= _oy + _sy || z >= _oz + _sz)
+        {
+            return false;
+        }
+
+        index = ((x - _ox) * _sy * _sz) + ((y - _oy) * _sz) + (z - _oz);
+        return true;
+    }
+    inline void compute(const std::vector<block_id> &grid)
+    {
+        // Unpack target key to components
+        const size_t x = _target_key / (_grid_scale * _grid_scale);
+        const size_t y = (_target_key / _grid_scale) % _grid_scale;
+        const size_t z = _target_key % _grid_scale;
+
+        // Calculate the region around the target
+        bounds(x, _ox, _sx);
+        bounds(y, _oy, _sy);
+        bounds(z, _oz, _sz);
+
+        // Mark all cells unreached
+        const size_t size = _sx * _sy * _sz;
+        std::fill(_dir.begin(), _dir.begin() + size, _unreached);
+
+        // If the target is inside terrain nothing is reachable
+        if (grid[_target_key] != block_id::EMPTY)
+        {
+            return;
+        }
+
+        // Seed the search with the target
+        size_t start = 0;
+        local_index(_target_key, start);
+        _dir[start] = _target;
+        _queue.clear();
+        _queue.push_back(static_cast<uint32_t>(start));
+
+        // Local region strides
+        const size_t sxy = _sy * _sz;
+
+        // Breadth first search outward from the target
+        for (size_t head = 0; head < _queue.size(); head++)
+        {
+            // Unpack local index to components
+            const size_t index = _queue[head];
+            const size_t lx = index / sxy;
+            const size_t ly = (index / _sz) % _sy;
+            const size_t lz = index % _sz;
+
+            // Function to reach a neighbor cell, face points from the neighbor back to this cell
+            const auto reach = [this, &grid](const size_t n, const size_t nx, const size_t ny, const size_t nz, const uint8_t face) {
+                if (_dir[n] == _unreached && grid[global_key(nx, ny, nz)] == block_id::EMPTY)
+                {
+                    _dir[n] = face;
+                    _queue.push_back(static_cast<uint32_t>(n));
+                }
+            };
+
+            // Faces are ordered -x, +x, -y, +y, -z, +z
+            if (lx != 0)
+            {
+                reach(index - sxy, lx - 1, ly, lz, 1);
+            }
+            if (lx + 1 != _sx)
+            {
+                reach(index + sxy, lx + 1, ly, lz, 0);
+            }
+            if (ly != 0)
+            {
+                reach(index - _sz, lx, ly - 1, lz, 3);
+            }
+            if (ly + 1 != _sy)
+            {
+                reach(index + _sz, lx, ly + 1, lz, 2);
+            }
+            if (lz != 0)
+            {
+                reach(index - 1, lx, ly, lz - 1, 5);
+            }
+            if (lz + 1 != _sz)
+            {
+                reach(index + 1, lx, ly, lz + 1, 4);
+            }
+        }
+    }
+
+  public:
+    flow_field(const size_t grid_scale, const size_t width)
+        : _grid_scale(grid_scale), _width(std::min(width, grid_scale)),
+          _dir(_width * _width * _width, _unreached),
+          _ox(0), _oy(0), _oz(0), _sx(0), _sy(0), _sz(0),
+          _target_key(0), _dirty(true)
+    {
+        // Reserve space for the search queue
+        _queue.reserve(_dir.size());
+    }
+    inline void invalidate()
+    {
+        _dirty = true;
+    }
+    inline bool path(std::vector<size_t> &out, const size_t start_key, const size_t stop_key, const size_t limit) const
+    {
+        // Field only knows paths to the current target
+        size_t index;
+        if (_dirty || stop_key != _target_key || !local_index(start_key, index))
+        {
+            return false;
+        }
+
+        // If the start cell can't reach the target
+        if (_dir[index] == _unreached)
+        {
+            return false;
+        }
+
+        // Local region strides
+        const size_t sxy = _sy * _sz;
+        const size_t gxy = _grid_scale * _grid_scale;
+
+        // Follow the gradient toward the target
+        out.clear();
+        size_t key = start_key;
+        while (out.size() < limit)
+        {
+            out.push_back(key);
+
+            // Step to the next cell
+            switch (_dir[index])
+            {
+            case 0:
+                index -= sxy;
+                key -= gxy;
+                break;
+            case 1:
+                index += sxy;
+                key += gxy;
+                break;
+            case 2:
+                index -= _sz;
+                key -= _grid_scale;
+                break;
+            case 3:
+                index += _sz;
+                key += _grid_scale;
+                break;
+            case 4:
+                index--;
+                key--;
+                break;
+            case 5:
+                index++;
+                key++;
+                break;
+            default:
+                return true;
+            }
+        }
+
+        return true;
+    }
+    inline void update(const std::vector<block_id> &grid, const size_t target_key)
+    {
+        // Only recompute when the target changes cell or terrain changed
+        if (_dirty || target_key != _target_key)
+        {
+            _target_key = target_key;
+            compute(grid);
+            _dirty = false;
+        }
+    }
+};
+}
+
+#endif
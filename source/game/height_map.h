@@ -20,6 +20,9 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <game/chunk_pipeline.h>
+#include <game/thread_pool.h>
 #include <random>
 #include <stdexcept>
 #include <vector>
@@ -34,192 +37,178 @@ class height_map
     size_t _size;
     T _lower;
     T _upper;
+    uint32_t _seed;
     std::vector<T> _map;
-    std::uniform_real_distribution<K> _dist;
-    std::mt19937 _gen;
+    std::vector<T> _scratch;
 
-    inline void blur()
+    inline static size_t blur_start(const size_t i, const size_t size)
+    {
+        // Window of five samples, shifted inward at the edges
+        if (i < 2)
+        {
+            return i;
+        }
+        else if (i < size - 2)
+        {
+            return i - 2;
+        }
+
+        return i - 4;
+    }
+    inline void blur(thread_pool &pool)
     {
         // Gaussian blur kernel, 5x5
         // Sigma = 1
         // exp(-(x * x + y * y) / 2), normalized on [-2, 2] for x and y
         const T kernel[5] = {0.05449, 0.24420, 0.40262, 0.24420, 0.05449};
 
-        // Image length and width
-        const size_t end2 = _size - 2;
-
-        // Create a copy of the image to populate map edges
-        std::vector<T> copy(_map.size(), 0.0);
-
-        // X Dimensional blur
-        {
-            for (size_t i = 0; i < 2; i++)
+        // X Dimensional blur into scratch, rows along y are contiguous
+        const auto blur_x = [this, &kernel](std::mt19937 &, const size_t i) {
+            T *const out = &_scratch[key(i, 0)];
+            const size_t start = blur_start(i, _size);
+            for (size_t j = 0; j < _size; j++)
+            {
+                out[j] = 0.0;
+            }
+            for (size_t k = 0; k < 5; k++)
             {
+                // Accumulate a whole row per tap, vectorized by the compiler
+                const T *const in = &_map[key(start + k, 0)];
+                const T w = kernel[k];
                 for (size_t j = 0; j < _size; j++)
                 {
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i + k, j);
-                        copy[key(i, j)] += _map[index] * kernel[k];
-                    }
+                    out[j] += in[j] * w;
                 }
             }
+        };
+        pool.run(std::cref(blur_x), 0, _size);
 
-            for (size_t i = 2; i < end2; i++)
+        // Y Dimensional blur back into the map
+        const auto blur_y = [this, &kernel](std::mt19937 &, const size_t i) {
+            const T *const in = &_scratch[key(i, 0)];
+            T *const out = &_map[key(i, 0)];
+
+            // Edges use shifted windows
+            const size_t end2 = _size - 2;
+            for (const size_t j : {size_t(0), size_t(1), end2, end2 + 1})
             {
-                // Starting position
-                const size_t i2 = i - 2;
-                for (size_t j = 0; j < _size; j++)
+                const size_t start = blur_start(j, _size);
+                T sum = 0.0;
+                for (size_t k = 0; k < 5; k++)
                 {
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i2 + k, j);
-                        copy[key(i, j)] += _map[index] * kernel[k];
-                    }
+                    sum += in[start + k] * kernel[k];
                 }
+                out[j] = sum;
             }
 
-            for (size_t i = end2; i < _size; i++)
+            // Centered window for the inside of the row
+            for (size_t j = 2; j < end2; j++)
             {
-                // Starting position
-                const size_t i4 = i - 4;
-                for (size_t j = 0; j < _size; j++)
+                T sum = 0.0;
+                for (size_t k = 0; k < 5; k++)
                 {
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i4 + k, j);
-                        copy[key(i, j)] += _map[index] * kernel[k];
-                    }
+                    sum += in[j - 2 + k] * kernel[k];
                 }
+                out[j] = sum;
             }
+        };
+        pool.run(std::cref(blur_y), 0, _size);
+    }
+    inline K random(const size_t index, const K lower, const K upper) const
+    {
+        // Hash the seed and cell so every cell has its own random value
+        const uint32_t h = chunk_pipeline::mix(_seed, index);
+
+        // Map the top 24 bits to [lower, upper)
+        const K unit = static_cast<K>(h >> 8) / static_cast<K>(1 << 24);
+        return lower + (upper - lower) * unit;
+    }
+    inline void generate(thread_pool &pool)
+    {
+        // Generate start indexes
+        const size_t end = _size - 1;
+
+        // Generate random values at corners
+        for (const size_t corner : {key(0, 0), key(end, 0), key(0, end), key(end, end)})
+        {
+            _map[corner] = random(corner, _lower, _upper);
         }
 
-        // Y Dimensional blur
+        // Diamond square a level at a time, cells in a level only read the levels above
+        size_t level = 1;
+        for (size_t length = end / 2; length > 0; length /= 2, level++)
         {
-            for (size_t i = 0; i < _size; i++)
-            {
-                for (size_t j = 0; j < 2; j++)
+            // Random offsets shrink with depth
+            const K lower = _lower / level;
+            const K upper = _upper / level;
+
+            // Diamond step, average the corners of each square
+            const size_t step = length * 2;
+            const size_t squares = end / step;
+            const auto diamond = [this, length, step, lower, upper](std::mt19937 &, const size_t i) {
+                const size_t x = i * step + length;
+                for (size_t y = length; y < _size; y += step)
                 {
-                    // Reset the map value
-                    _map[key(i, j)] = 0.0;
-
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
-                    {
-                        const size_t index = key(i, j + k);
-                        _map[key(i, j)] += copy[index] * kernel[k];
-                    }
+                    const size_t ll = key(x - length, y - length);
+                    const size_t lr = key(x + length, y - length);
+                    const size_t ul = key(x - length, y + length);
+                    const size_t ur = key(x + length, y + length);
+                    const size_t center = key(x, y);
+                    _map[center] = random(center, lower, upper) + (_map[ll] + _map[ul] + _map[lr] + _map[ur]) / 4;
                 }
-                for (size_t j = end2; j < _size; j++)
+            };
+            pool.run(std::cref(diamond), 0, squares);
+
+            // Square step, average the neighbors of each edge midpoint inside the map
+            const size_t rows = end / length + 1;
+            const auto square = [this, end, length, lower, upper](std::mt19937 &, const size_t i) {
+                const size_t x = i * length;
+                for (size_t y = ((i % 2) == 0) ? length : 0; y < _size; y += length * 2)
                 {
-                    // Starting position
-                    const size_t j4 = j - 4;
-
-                    // Reset the map value
-                    _map[key(i, j)] = 0.0;
-
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
+                    T sum = 0.0;
+                    size_t count = 0;
+                    if (x >= length)
                     {
-                        const size_t index = key(i, j4 + k);
-                        _map[key(i, j)] += copy[index] * kernel[k];
+                        sum += _map[key(x - length, y)];
+                        count++;
                     }
-                }
-            }
-
-            for (size_t i = 0; i < _size; i++)
-            {
-                for (size_t j = 2; j < end2; j++)
-                {
-                    // Starting position
-                    const size_t j2 = j - 2;
-
-                    // Reset the map value
-                    _map[key(i, j)] = 0.0;
-
-                    // Summing convolution
-                    for (size_t k = 0; k < 5; k++)
+                    if (x + length <= end)
+                    {
+                        sum += _map[key(x + length, y)];
+                        count++;
+                    }
+                    if (y >= length)
+                    {
+                        sum += _map[key(x, y - length)];
+                        count++;
+                    }
+                    if (y + length <= end)
                     {
-                        const size_t index = key(i, j2 + k);
-                        _map[key(i, j)] += copy[index] * kernel[k];
+                        sum += _map[key(x, y + length)];
+                        count++;
                     }
+                    const size_t index = key(x, y);
+                    _map[index] = random(index, lower, upper) + sum / count;
                 }
-            }
+            };
+            pool.run(std::cref(square), 0, rows);
         }
     }
-    inline void generate()
-    {
-        // Generate start indexes
-        const size_t end = _size - 1;
-
-        // Generate corner keys
-        const size_t ll = key(0, 0);
-        const size_t lr = key(end, 0);
-        const size_t ul = key(0, end);
-        const size_t ur = key(end, end);
-
-        // Generate random values at corners
-        _map[ll] = _dist(_gen);
-        _map[lr] = _dist(_gen);
-        _map[ul] = _dist(_gen);
-        _map[ur] = _dist(_gen);
-
-        // Recursively diamond square
-        const size_t mid_point = end / 2;
-        diamond_square(mid_point, mid_point, mid_point, 1);
-    }
     inline size_t key(const size_t x, const size_t y) const
     {
         return _size * x + y;
     }
-    inline void diamond_square(const size_t x, const size_t y, const size_t length, const size_t level)
-    {
-        // Generate diamond keys
-        const size_t ll = key(x - length, y - length);
-        const size_t lr = key(x + length, y - length);
-        const size_t ul = key(x - length, y + length);
-        const size_t ur = key(x + length, y + length);
-
-        // Generate average value at center
-        const size_t center = key(x, y);
-        _map[center] = _dist(_gen) + (_map[ll] + _map[ul] + _map[lr] + _map[ur]) / 4;
-
-        // Generate square keys
-        const size_t l = key(x - length, y);
-        const size_t r = key(x + length, y);
-        const size_t d = key(x, y - length);
-        const size_t u = key(x, y + length);
-
-        // Generate random values at corners
-        _map[l] = _dist(_gen) + (_map[ll] + _map[ul] + _map[center]) / 3;
-        _map[r] = _dist(_gen) + (_map[lr] + _map[ur] + _map[center]) / 3;
-        _map[d] = _dist(_gen) + (_map[ll] + _map[lr] + _map[center]) / 3;
-        _map[u] = _dist(_gen) + (_map[ul] + _map[ur] + _map[center]) / 3;
-
-        // Recursively call this function
-        const size_t half = length / 2;
-        if (half > 0)
-        {
-            _dist = std::uniform_real_distribution<K>(_lower / level, _upper / level);
-            diamond_square(x - half, y - half, half, level + 1);
-            diamond_square(x + half, y - half, half, level + 1);
-            diamond_square(x - half, y + half, half, level + 1);
-            diamond_square(x + half, y + half, half, level + 1);
-        }
-    }
     inline static size_t pow2(const size_t level)
     {
         return 1 << level;
     }
 
   public:
-    height_map(const size_t level, const T lower, const T upper)
-        : _size(pow2(level) + 1), _lower(lower), _upper(upper),
-          _map(_size * _size), _dist(_lower, _upper),
-          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+    height_map(thread_pool &pool, const size_t level, const T lower, const T upper)
+        : height_map(pool, level, lower, upper, std::chrono::high_resolution_clock::now().time_since_epoch().count()) {}
+    height_map(thread_pool &pool, const size_t level, const T lower, const T upper, const uint32_t seed)
+        : _size(pow2(level) + 1), _lower(lower), _upper(upper), _seed(seed),
+          _map(_size * _size), _scratch(_map.size())
     {
         // Map size must be odd, and greater than one
         if (level == 0)
@@ -228,10 +217,13 @@ class height_map
         }
 
         // Generate the random height map
-        generate();
+        generate(pool);
 
         // Use a gaussian blur on the height map
-        blur();
+        blur(pool);
+
+        // Release the blur scratch
+        std::vector<T>().swap(_scratch);
     }
     inline const T get(const size_t x, const size_t y) const
     {
@@ -23,8 +23,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <game/id.h>
 #include <game/inventory.h>
 #include <game/options.h>
+#include <game/save_queue.h>
+#include <game/snapshot.h>
 #include <game/static_instance.h>
 #include <game/stats.h>
+#include <game/world_seed.h>
 #include <iostream>
 #include <limits>
 #include <min/vec3.h>
@@ -59,6 +62,16 @@ struct game_state
 class load_state
 {
   private:
+    static constexpr uint32_t _magic = snapshot_id("BDSS");
+    static constexpr uint32_t _version = 1;
+    static constexpr uint32_t _section_version = 1;
+    static constexpr uint32_t _grid_id = snapshot_id("GRID");
+    static constexpr uint32_t _mode_id = snapshot_id("MODE");
+    static constexpr uint32_t _player_id = snapshot_id("PLAY");
+    static constexpr uint32_t _inventory_id = snapshot_id("INVE");
+    static constexpr uint32_t _stat_id = snapshot_id("STAT");
+    static constexpr uint32_t _chest_id = snapshot_id("CHES");
+    static constexpr uint32_t _seed_id = snapshot_id("SEED");
     uint32_t _grid_size;
     min::vec3<float> _default_spawn;
     min::vec3<float> _default_look;
@@ -66,7 +79,10 @@ class load_state
     min::vec3<float> _top;
     int_fast8_t _game_mode;
     bool _new_game;
+    bool _has_inventory;
+    bool _has_stats;
     game_state _state;
+    world_seed _seed;
 
     inline void check_inside()
     {
@@ -108,139 +124,285 @@ class load_state
         const size_t chest_size = static_instance::max_chests();
         _state.chest.reserve(chest_size);
     }
-    inline void state_load_file()
+    inline void load_chests(const std::vector<uint8_t> &stream, size_t &next)
     {
-        // Create output stream for loading world
-        std::vector<uint8_t> stream;
-
-        // Load data into stream from file
-        load_file("bin/state", stream);
-
-        // If load failed dont try to parse stream data
-        if (stream.size() != 0)
+        // Load the chest positions
+        const size_t chest_size = min::read_le<uint32_t>(stream, next);
+        if (chest_size > static_instance::max_chests())
         {
-            // Flag that this is not a new game
-            _new_game = false;
-
-            // Character position
-            size_t next = 0;
-
-            // Read grid size from stream
-            const uint32_t grid_size = min::read_le<uint32_t>(stream, next);
-            if (grid_size != _grid_size)
-            {
-                // Warn user that grid sizes not compatible
-                std::cout << "Resizing the grid: deleting old save caches" << std::endl;
+            throw std::runtime_error("load_state: incompatible chest size");
+        }
 
-                // Erase previous state files
-                game::erase_file("bin/state");
-                game::erase_file("bin/world.bmesh");
+        // Copy data
+        for (size_t i = 0; i < chest_size; i++)
+        {
+            _state.chest.push_back(min::read_le_vec3<float>(stream, next));
+        }
+    }
+    inline void load_inventory(const std::vector<uint8_t> &stream, size_t &next)
+    {
+        // Load inventory data from stream
+        const size_t start = inventory::begin_store();
+        const size_t end = inventory::end_cube();
+        const uint32_t inv_size = end - start;
+        const uint32_t read_inv_size = min::read_le<uint32_t>(stream, next);
 
-                // Early return
-                return;
-            }
+        // Check inventory array size
+        if (read_inv_size > inventory::size() || read_inv_size != inv_size)
+        {
+            throw std::runtime_error("load_state: incompatible inventory size");
+        }
 
-            // Load the game mode
-            const int_fast8_t game_mode = min::read_le<uint8_t>(stream, next);
-            if (_game_mode == 2)
+        // Copy data
+        for (size_t i = start; i < end; i++)
+        {
+            const item_id id = static_cast<item_id>(min::read_le<uint8_t>(stream, next));
+            const int_fast8_t count = min::read_le<uint8_t>(stream, next);
+            const int_fast8_t prim = min::read_le<uint8_t>(stream, next);
+            const int_fast8_t sec = min::read_le<uint8_t>(stream, next);
+            const int_fast8_t level = min::read_le<uint8_t>(stream, next);
+            _state.inventory.emplace_back(id, count, prim, sec, level);
+        }
+    }
+    inline void load_mode(const int_fast8_t game_mode)
+    {
+        if (_game_mode == 2)
+        {
+            // Keep the loaded flag
+            _game_mode = game_mode;
+        }
+        else if (_game_mode != game_mode)
+        {
+            // Alert mode switch to user
+            if (_game_mode == 1)
             {
-                // Keep the loaded flag
-                _game_mode = game_mode;
+                std::cout << "Switching game mode to HARDCORE!" << std::endl;
             }
-            else if (_game_mode != game_mode)
+            else
             {
-                // Alert mode switch to user
-                if (_game_mode == 1)
-                {
-                    std::cout << "Switching game mode to HARDCORE!" << std::endl;
-                }
-                else
-                {
-                    std::cout << "Switching game mode to NORMAL!" << std::endl;
-                }
+                std::cout << "Switching game mode to NORMAL!" << std::endl;
             }
+        }
+    }
+    inline void load_player(const std::vector<uint8_t> &stream, size_t &next)
+    {
+        // Read position from stream
+        const float x = min::read_le<float>(stream, next);
+        const float y = min::read_le<float>(stream, next);
+        const float z = min::read_le<float>(stream, next);
 
-            // Read position from stream
-            const float x = min::read_le<float>(stream, next);
-            const float y = min::read_le<float>(stream, next);
-            const float z = min::read_le<float>(stream, next);
+        // Load position
+        _state.position = min::vec3<float>(x, y, z);
 
-            // Load position
-            _state.position = min::vec3<float>(x, y, z);
+        // Look direction
+        const float lx = min::read_le<float>(stream, next);
+        const float ly = min::read_le<float>(stream, next);
+        const float lz = min::read_le<float>(stream, next);
 
-            // Look direction
-            const float lx = min::read_le<float>(stream, next);
-            const float ly = min::read_le<float>(stream, next);
-            const float lz = min::read_le<float>(stream, next);
+        // Load look vector
+        _state.look = min::vec3<float>(lx, ly, lz);
 
-            // Load look vector
-            _state.look = min::vec3<float>(lx, ly, lz);
+        // Up vector
+        const float ux = min::read_le<float>(stream, next);
+        const float uy = min::read_le<float>(stream, next);
+        const float uz = min::read_le<float>(stream, next);
 
-            // Up vector
-            const float ux = min::read_le<float>(stream, next);
-            const float uy = min::read_le<float>(stream, next);
-            const float uz = min::read_le<float>(stream, next);
+        // Load look vector
+        _state.up = min::vec3<float>(ux, uy, uz);
+    }
+    inline void load_stats(const std::vector<uint8_t> &stream, size_t &next)
+    {
+        // Load stats from stream
+        const size_t stat_size = stats::stat_str_size();
+        const uint32_t read_stat_size = min::read_le<uint32_t>(stream, next);
+
+        // Check inventory array size
+        if (read_stat_size != stat_size)
+        {
+            throw std::runtime_error("load_state: incompatible stat size");
+        }
+
+        // Copy data
+        for (size_t i = 0; i < stat_size; i++)
+        {
+            _state.stat[i] = min::read_le<uint16_t>(stream, next);
+        }
+
+        // Load misc data
+        _state.stat_points = min::read_le<uint16_t>(stream, next);
+        _state.energy = min::read_le<float>(stream, next);
+        _state.exp = min::read_le<float>(stream, next);
+        _state.health = min::read_le<float>(stream, next);
+        _state.oxygen = min::read_le<float>(stream, next);
+    }
+    inline void load_legacy(const std::vector<uint8_t> &stream)
+    {
+        // Old saves are a headerless stream of every field in order
+        size_t next = 0;
+        const uint32_t grid_size = min::read_le<uint32_t>(stream, next);
+        load_mode(min::read_le<uint8_t>(stream, next));
+        load_player(stream, next);
+        load_inventory(stream, next);
+        load_stats(stream, next);
+        load_chests(stream, next);
+        _has_inventory = true;
+        _has_stats = true;
+
+        // Load the world seed, older saves get a new world
+        if (next + sizeof(uint32_t) + sizeof(uint8_t) <= stream.size())
+        {
+            const uint32_t seed = min::read_le<uint32_t>(stream, next);
+            const bool portal = min::read_le<uint8_t>(stream, next) != 0;
+            _seed = world_seed(seed, portal);
+        }
 
-            // Load look vector
-            _state.up = min::vec3<float>(ux, uy, uz);
+        // Keep inventory and stats from saves on a different grid
+        if (grid_size != _grid_size)
+        {
+            migrate_grid();
+        }
+    }
+    inline const snapshot_section *load_section(const snapshot_reader &reader, const uint32_t id, const char *const name) const
+    {
+        // Check the section exists and is intact
+        const snapshot_section *const section = reader.find(id, true);
+        if (!section)
+        {
+            std::cout << "load_state: missing or corrupt section '" << name << "', using defaults" << std::endl;
+        }
+        else if (section->version != _section_version)
+        {
+            std::cout << "load_state: unknown version of section '" << name << "', using defaults" << std::endl;
+            return nullptr;
+        }
 
-            // Load inventory data from stream
-            const size_t start = inventory::begin_store();
-            const size_t end = inventory::end_cube();
-            const uint32_t inv_size = end - start;
-            const uint32_t read_inv_size = min::read_le<uint32_t>(stream, next);
+        return section;
+    }
+    inline void load_sections(const std::vector<uint8_t> &stream, const snapshot_reader &reader)
+    {
+        // Grid size decides if positions are still valid
+        const snapshot_section *const grid = load_section(reader, _grid_id, "GRID");
+        uint32_t grid_size = 0;
+        if (grid)
+        {
+            size_t next = grid->offset;
+            grid_size = min::read_le<uint32_t>(stream, next);
+        }
 
-            // Check inventory array size
-            if (read_inv_size > inventory::size() || read_inv_size != inv_size)
+        // Load the game mode
+        const snapshot_section *const mode = load_section(reader, _mode_id, "MODE");
+        if (mode)
+        {
+            size_t next = mode->offset;
+            load_mode(min::read_le<uint8_t>(stream, next));
+        }
+        else if (_game_mode == 2)
+        {
+            // Default to normal mode
+            _game_mode = 0;
+        }
+
+        // Positions only make sense on the same grid
+        if (grid_size == _grid_size)
+        {
+            const snapshot_section *const player = load_section(reader, _player_id, "PLAY");
+            if (player)
             {
-                throw std::runtime_error("load_state: incompatible inventory size");
+                size_t next = player->offset;
+                load_player(stream, next);
             }
 
-            // Copy data
-            for (size_t i = start; i < end; i++)
+            const snapshot_section *const chest = load_section(reader, _chest_id, "CHES");
+            if (chest)
             {
-                const item_id id = static_cast<item_id>(min::read_le<uint8_t>(stream, next));
-                const int_fast8_t count = min::read_le<uint8_t>(stream, next);
-                const int_fast8_t prim = min::read_le<uint8_t>(stream, next);
-                const int_fast8_t sec = min::read_le<uint8_t>(stream, next);
-                const int_fast8_t level = min::read_le<uint8_t>(stream, next);
-                _state.inventory.emplace_back(id, count, prim, sec, level);
+                size_t next = chest->offset;
+                load_chests(stream, next);
             }
+        }
+        else
+        {
+            migrate_grid();
+        }
 
-            // Load stats from stream
-            const size_t stat_size = stats::stat_str_size();
-            const uint32_t read_stat_size = min::read_le<uint32_t>(stream, next);
-
-            // Check inventory array size
-            if (read_stat_size != stat_size)
+        // Load inventory, a bad section keeps the new game inventory
+        const snapshot_section *const inv = load_section(reader, _inventory_id, "INVE");
+        if (inv)
+        {
+            try
+            {
+                size_t next = inv->offset;
+                load_inventory(stream, next);
+                _has_inventory = true;
+            }
+            catch (const std::runtime_error &ex)
             {
-                throw std::runtime_error("load_state: incompatible stat size");
+                std::cout << ex.what() << ", using defaults" << std::endl;
+                _state.inventory.clear();
             }
+        }
 
-            // Copy data
-            for (size_t i = 0; i < stat_size; i++)
+        // Load stats, a bad section keeps the new game stats
+        const snapshot_section *const stat = load_section(reader, _stat_id, "STAT");
+        if (stat)
+        {
+            try
+            {
+                size_t next = stat->offset;
+                load_stats(stream, next);
+                _has_stats = true;
+            }
+            catch (const std::runtime_error &ex)
             {
-                _state.stat[i] = min::read_le<uint16_t>(stream, next);
+                std::cout << ex.what() << ", using defaults" << std::endl;
             }
+        }
+
+        // Load the world seed
+        const snapshot_section *const seed = load_section(reader, _seed_id, "SEED");
+        if (seed)
+        {
+            size_t next = seed->offset;
+            const uint32_t value = min::read_le<uint32_t>(stream, next);
+            const bool portal = min::read_le<uint8_t>(stream, next) != 0;
+            _seed = world_seed(value, portal);
+        }
+    }
+    inline void migrate_grid()
+    {
+        // Warn user that the world will be regenerated
+        std::cout << "load_state: grid size changed, keeping inventory and stats" << std::endl;
+
+        // Positions in the old world are not valid
+        _state.position = _default_spawn;
+        _state.look = _default_look;
+        _state.up = _default_up;
+        _state.chest.clear();
+    }
+    inline void state_load_file()
+    {
+        // Create output stream for loading world
+        std::vector<uint8_t> stream;
 
-            // Load misc data
-            _state.stat_points = min::read_le<uint16_t>(stream, next);
-            _state.energy = min::read_le<float>(stream, next);
-            _state.exp = min::read_le<float>(stream, next);
-            _state.health = min::read_le<float>(stream, next);
-            _state.oxygen = min::read_le<float>(stream, next);
+        // Finish pending writes and interrupted replaces, then load data into stream from file
+        save_queue::writer.wait();
+        recover_file("bin/state");
+        load_file("bin/state", stream);
 
-            // Load the chest positions
-            const size_t chest_size = min::read_le<uint32_t>(stream, next);
-            if (chest_size > static_instance::max_chests())
+        // If load failed dont try to parse stream data
+        if (stream.size() != 0)
+        {
+            // Flag that this is not a new game
+            _new_game = false;
+
+            // Read the section table or fall back to the old format
+            snapshot_reader reader;
+            if (reader.open(&stream[0], stream.size(), _magic))
             {
-                throw std::runtime_error("load_state: incompatible chest size");
+                load_sections(stream, reader);
             }
-
-            // Copy data
-            for (size_t i = 0; i < chest_size; i++)
+            else
             {
-                _state.chest.push_back(min::read_le_vec3<float>(stream, next));
+                load_legacy(stream);
             }
         }
         else
@@ -259,6 +421,8 @@ class load_state
           _top(0.0, _grid_size - 1.0, 0.0),
           _game_mode(opt.mode()),
           _new_game(true),
+          _has_inventory(false),
+          _has_stats(false),
           _state(_default_spawn, _default_look, _default_up)
     {
         // Check for integer overflow
@@ -292,6 +456,18 @@ class load_state
     {
         return _top;
     }
+    inline const world_seed &get_world_seed() const
+    {
+        return _seed;
+    }
+    inline bool has_inventory() const
+    {
+        return _has_inventory;
+    }
+    inline bool has_stats() const
+    {
+        return _has_stats;
+    }
     inline bool is_hardcore() const
     {
         return _game_mode == 1;
@@ -346,75 +522,88 @@ class load_state
     }
     inline void save_state()
     {
-        // Create output stream for saving world
-        std::vector<uint8_t> stream;
-
-        // Cache the file size
-        stream.reserve(438);
-
-        // Write the grid size into stream
-        min::write_le<uint32_t>(stream, _grid_size);
-
-        // Write the game mode into stream
-        min::write_le<uint8_t>(stream, _game_mode);
-
-        // Write position into stream
-        min::write_le<float>(stream, _state.position.x());
-        min::write_le<float>(stream, _state.position.y());
-        min::write_le<float>(stream, _state.position.z());
-
-        // Get the camera look and write into stream
-        min::write_le<float>(stream, _state.look.x());
-        min::write_le<float>(stream, _state.look.y());
-        min::write_le<float>(stream, _state.look.z());
-
-        // Get the camera up and write into stream
-        min::write_le<float>(stream, _state.up.x());
-        min::write_le<float>(stream, _state.up.y());
-        min::write_le<float>(stream, _state.up.z());
-
-        // Write inventory data into stream
+        // Each part of the state is a checked section
+        snapshot_writer writer(_magic, _version, 512);
+
+        // Write the grid size
+        std::vector<uint8_t> &grid = writer.begin(_grid_id, _section_version);
+        min::write_le<uint32_t>(grid, _grid_size);
+        writer.end();
+
+        // Write the game mode
+        std::vector<uint8_t> &mode = writer.begin(_mode_id, _section_version);
+        min::write_le<uint8_t>(mode, _game_mode);
+        writer.end();
+
+        // Write position, camera look and camera up
+        std::vector<uint8_t> &player = writer.begin(_player_id, _section_version);
+        min::write_le<float>(player, _state.position.x());
+        min::write_le<float>(player, _state.position.y());
+        min::write_le<float>(player, _state.position.z());
+        min::write_le<float>(player, _state.look.x());
+        min::write_le<float>(player, _state.look.y());
+        min::write_le<float>(player, _state.look.z());
+        min::write_le<float>(player, _state.up.x());
+        min::write_le<float>(player, _state.up.y());
+        min::write_le<float>(player, _state.up.z());
+        writer.end();
+
+        // Write inventory data
+        std::vector<uint8_t> &inv = writer.begin(_inventory_id, _section_version);
         const uint32_t inv_size = _state.inventory.size();
-        min::write_le<uint32_t>(stream, inv_size);
+        min::write_le<uint32_t>(inv, inv_size);
         for (size_t i = 0; i < inv_size; i++)
         {
             const item &it = _state.inventory[i];
-            min::write_le<uint8_t>(stream, static_cast<uint8_t>(it.id()));
-            min::write_le<uint8_t>(stream, it.count());
-            min::write_le<uint8_t>(stream, it.primary());
-            min::write_le<uint8_t>(stream, it.secondary());
-            min::write_le<uint8_t>(stream, it.level());
+            min::write_le<uint8_t>(inv, static_cast<uint8_t>(it.id()));
+            min::write_le<uint8_t>(inv, it.count());
+            min::write_le<uint8_t>(inv, it.primary());
+            min::write_le<uint8_t>(inv, it.secondary());
+            min::write_le<uint8_t>(inv, it.level());
         }
+        writer.end();
 
-        // Write stats into stream
+        // Write stats and misc data
+        std::vector<uint8_t> &stat = writer.begin(_stat_id, _section_version);
         const uint32_t stat_size = _state.stat.size();
-        min::write_le<uint32_t>(stream, stat_size);
+        min::write_le<uint32_t>(stat, stat_size);
         for (size_t i = 0; i < stat_size; i++)
         {
-            min::write_le<uint16_t>(stream, _state.stat[i]);
+            min::write_le<uint16_t>(stat, _state.stat[i]);
         }
-
-        // Save misc data
-        min::write_le<uint16_t>(stream, _state.stat_points);
-        min::write_le<float>(stream, _state.energy);
-        min::write_le<float>(stream, _state.exp);
-        min::write_le<float>(stream, _state.health);
-        min::write_le<float>(stream, _state.oxygen);
-
-        // Write chests into stream
+        min::write_le<uint16_t>(stat, _state.stat_points);
+        min::write_le<float>(stat, _state.energy);
+        min::write_le<float>(stat, _state.exp);
+        min::write_le<float>(stat, _state.health);
+        min::write_le<float>(stat, _state.oxygen);
+        writer.end();
+
+        // Write chests
+        std::vector<uint8_t> &chest = writer.begin(_chest_id, _section_version);
         const size_t chest_size = _state.chest.size();
-        min::write_le<uint32_t>(stream, static_cast<uint32_t>(chest_size));
+        min::write_le<uint32_t>(chest, static_cast<uint32_t>(chest_size));
         for (size_t i = 0; i < chest_size; i++)
         {
             // Save the chest locations
             const min::vec3<float> &p = _state.chest[i];
 
             // !!! - Undo chest adjustment, in world.h - !!!!
-            min::write_le_vec3<float>(stream, min::vec3<float>(p.x(), p.y() + 1.0, p.z()));
+            min::write_le_vec3<float>(chest, min::vec3<float>(p.x(), p.y() + 1.0, p.z()));
         }
+        writer.end();
 
-        // Write data to file
-        save_file("bin/state", stream);
+        // Write the world seed, the world file only stores changes from this world
+        std::vector<uint8_t> &seed = writer.begin(_seed_id, _section_version);
+        min::write_le<uint32_t>(seed, _seed.seed());
+        min::write_le<uint8_t>(seed, _seed.is_portal() ? 1 : 0);
+        writer.end();
+
+        // Write data to file on the save thread
+        save_queue::writer.replace("bin/state", std::move(writer.finish()));
+    }
+    inline void set_world_seed(const world_seed &seed)
+    {
+        _seed = seed;
     }
     inline void set_state(const min::vec3<float> &p, const min::camera<float> &camera, const inventory &inv, const stats &stat, const static_instance &si)
     {
@@ -0,0 +1,164 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MAPPED_FILE__
+#define __MAPPED_FILE__
+
+#include <cstdint>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace game
+{
+
+class mapped_file
+{
+  private:
+    const uint8_t *_data;
+    size_t _size;
+#if defined(_WIN32)
+    HANDLE _file;
+    HANDLE _map;
+#else
+    int _fd;
+#endif
+
+  public:
+#if defined(_WIN32)
+    mapped_file() : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _map(nullptr) {}
+#else
+    mapped_file() : _data(nullptr), _size(0), _fd(-1) {}
+#endif
+    ~mapped_file()
+    {
+        close();
+    }
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    inline void close()
+    {
+#if defined(_WIN32)
+        if (_data)
+        {
+            UnmapViewOfFile(_data);
+        }
+        if (_map)
+        {
+            CloseHandle(_map);
+        }
+        if (_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(_file);
+        }
+        _file = INVALID_HANDLE_VALUE;
+        _map = nullptr;
+#else
+        if (_data)
+        {
+            munmap(const_cast<uint8_t *>(_data), _size);
+        }
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+        _fd = -1;
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+    inline const uint8_t *data() const
+    {
+        return _data;
+    }
+    inline bool is_open() const
+    {
+        return _data != nullptr;
+    }
+    inline bool open(const std::string &file_name)
+    {
+        // Release any previous mapping
+        close();
+
+#if defined(_WIN32)
+        // Open the file and get the size
+        _file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+
+        // Map the whole file read only
+        _map = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!_map)
+        {
+            close();
+            return false;
+        }
+        _data = static_cast<const uint8_t *>(MapViewOfFile(_map, FILE_MAP_READ, 0, 0, 0));
+        _size = static_cast<size_t>(size.QuadPart);
+#else
+        // Open the file and get the size
+        _fd = ::open(file_name.c_str(), O_RDONLY);
+        struct stat st;
+        if (_fd < 0 || fstat(_fd, &st) != 0 || st.st_size == 0)
+        {
+            close();
+            return false;
+        }
+
+        // Map the whole file read only
+        void *const ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            close();
+            return false;
+        }
+        _data = static_cast<const uint8_t *>(ptr);
+        _size = static_cast<size_t>(st.st_size);
+#endif
+
+        // Check the mapping succeeded
+        if (!_data)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+    inline size_t size() const
+    {
+        return _size;
+    }
+};
+}
+
+#endif
@@ -84,12 +84,14 @@ class path
     min::bezier_deriv<float, min::vec3> _curve;
     min::vec3<float> _target;
     min::vec3<float> _last;
+    min::vec3<float> _coast;
     path_data _data;
     bool _bezier_interp;
     float _curve_dist;
     float _curve_interp;
     size_t _path_index;
     bool _is_dead;
+    bool _is_pending;
     bool _is_stuck;
 
     inline min::vec3<float> calculate_direction() const
@@ -200,7 +202,7 @@ class path
         : _bezier_interp(false),
           _curve_dist(0.0), _curve_interp(0.0),
           _path_index(0),
-          _is_dead(true), _is_stuck(false)
+          _is_dead(true), _is_pending(false), _is_stuck(false)
     {
         // Reserve space for path
         _path.reserve(100);
@@ -221,56 +223,81 @@ class path
     {
         return _is_dead;
     }
+    inline bool is_pending() const
+    {
+        return _is_pending;
+    }
     inline bool is_stuck() const
     {
         return _is_stuck;
     }
-    inline void set_dead(const bool flag)
+    inline bool need_path() const
     {
-        _is_dead = flag;
+        return _path.size() == 0 && !_is_pending;
     }
-    inline const min::vec3<float> step(cgrid &grid)
+    inline void search(cgrid &grid)
     {
+        // Request is being serviced
+        _is_pending = false;
+
         // Get data points
         const min::vec3<float> &p = _data.position();
         const min::vec3<float> &dest = _data.destination();
 
-        // If we need to compute a path
-        if (_path.size() == 0)
-        {
-            // Update path vector
-            grid.path(_path, p, dest);
+        // Update path vector
+        grid.path(_path, p, dest);
 
-            // If we got a path from grid
-            if (_path.size() > 0)
-            {
-                // Reset path index
-                _path_index = 0;
-
-                // Reset last point
-                _last = p;
+        // If we got a path from grid
+        if (_path.size() > 0)
+        {
+            // Reset path index
+            _path_index = 0;
 
-                // Reset the bezier curve if have enough points
-                if (_path.size() >= 3)
-                {
-                    set_bezier_interpolation(p);
-                }
-                else
-                {
-                    set_linear_interpolation();
-                }
+            // Reset last point
+            _last = p;
 
-                // Calculate direction
-                return calculate_direction();
+            // Reset the bezier curve if have enough points
+            if (_path.size() >= 3)
+            {
+                set_bezier_interpolation(p);
             }
             else
             {
-                // Flag that we are stuck
-                _is_stuck = true;
+                set_linear_interpolation();
             }
         }
         else
         {
+            // Flag that we are stuck
+            _is_stuck = true;
+        }
+    }
+    inline void set_dead(const bool flag)
+    {
+        _is_dead = flag;
+
+        // Forget any queued request and old heading
+        _is_pending = false;
+        _coast = min::vec3<float>();
+    }
+    inline void set_pending()
+    {
+        _is_pending = true;
+    }
+    inline const min::vec3<float> step()
+    {
+        // If we are waiting for a path
+        if (_path.size() == 0)
+        {
+            // Coast along the previous direction
+            min::vec3<float> coast = _coast;
+            return coast.normalize_safe(_data.direction());
+        }
+        else
+        {
+            // Get current position
+            const min::vec3<float> &p = _data.position();
+
             // Calculate the distance from the last point
             const min::vec3<float> accum_vec = p - _last;
             const float accum_dist = accum_vec.dot(accum_vec);
@@ -284,14 +311,14 @@ class path
             // Calculate direction
             const min::vec3<float> out = calculate_direction();
 
+            // Remember heading for coasting while waiting for the next path
+            _coast = out;
+
             // Check if path has expired
             expire_path();
 
             return out;
         }
-
-        // Failure fallback
-        return _data.direction();
     }
     inline void update(const min::vec3<float> &p, const min::vec3<float> &dest)
     {
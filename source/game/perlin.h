@@ -20,6 +20,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <array>
 #include <chrono>
+#include <cstdint>
 #include <min/vec3.h>
 #include <random>
 
@@ -30,11 +31,22 @@ class perlin_noise
 {
   private:
     std::array<uint_fast8_t, 512> _p;
+    std::array<float, 16> _gx;
+    std::array<float, 16> _gy;
+    std::array<float, 16> _gz;
 
-    void calc_random_hash_table()
+    void calc_gradient_table()
+    {
+        // Gradient components for each case of g()
+        _gx = {1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 1, 0, -1, 0};
+        _gy = {1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1, 1, -1, 1, -1};
+        _gz = {0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1, 0, 1, 0, -1};
+    }
+
+    void calc_random_hash_table(const uint32_t seed)
     {
         std::uniform_int_distribution<uint_fast8_t> idist(0, 255);
-        std::mt19937 gen(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        std::mt19937 gen(seed);
 
         const size_t size = _p.size();
         for (size_t i = 0; i < size; i++)
@@ -96,7 +108,14 @@ class perlin_noise
     perlin_noise()
     {
         // Calculate random numbers
-        calc_random_hash_table();
+        calc_random_hash_table(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        calc_gradient_table();
+    }
+    perlin_noise(const uint32_t seed)
+    {
+        // The same seed always makes the same noise
+        calc_random_hash_table(seed);
+        calc_gradient_table();
     }
     inline float perlin(const float x, const float y, const float z) const
     {
@@ -148,6 +167,81 @@ class perlin_noise
         // Interpolate along Z, map [-2, 2] to [0, 1]
         return lerp(y_zm, y_zp, v) * 0.25 + 0.5;
     }
+    inline void perlin(const float x, const float y, const float *const z, float *const out, const size_t size) const
+    {
+        // Calculate hash table indices shared by the row
+        const uint_fast8_t xim = static_cast<uint_fast8_t>(x) & 255;
+        const uint_fast8_t yim = static_cast<uint_fast8_t>(y) & 255;
+        const uint_fast8_t xip = xim + 1;
+        const uint_fast8_t yip = yim + 1;
+        const uint_fast8_t mm = _p[_p[xim] + yim];
+        const uint_fast8_t mp = _p[_p[xim] + yip];
+        const uint_fast8_t pm = _p[_p[xip] + yim];
+        const uint_fast8_t pp = _p[_p[xip] + yip];
+
+        // Calculate distance vector and interpolation constants shared by the row
+        const float xp = x - static_cast<uint_fast8_t>(x);
+        const float yp = y - static_cast<uint_fast8_t>(y);
+        const float xm = xp - 1.0;
+        const float ym = yp - 1.0;
+        const float t = fade(xp);
+        const float u = fade(yp);
+
+        // Samples in the same unit cube share all eight gradients
+        size_t begin = 0;
+        while (begin < size)
+        {
+            // Find the run of samples in this cube
+            const uint_fast8_t zi = static_cast<uint_fast8_t>(z[begin]);
+            size_t end = begin + 1;
+            while (end < size && static_cast<uint_fast8_t>(z[end]) == zi)
+            {
+                end++;
+            }
+
+            // Look up gradients of the corners, corners are ordered mmm, pmm, mpm, ppm, mmp, pmp, mpp, ppp
+            const uint_fast8_t zim = zi & 255;
+            const uint_fast8_t zip = zim + 1;
+            const std::array<uint_fast8_t, 8> h = {_p[mm + zim], _p[pm + zim], _p[mp + zim], _p[pp + zim],
+                                                   _p[mm + zip], _p[pm + zip], _p[mp + zip], _p[pp + zip]};
+            const std::array<float, 8> cx = {xm, xp, xm, xp, xm, xp, xm, xp};
+            const std::array<float, 8> cy = {ym, ym, yp, yp, ym, ym, yp, yp};
+
+            // The x and y part of each dot product is constant in the cube
+            std::array<float, 8> a;
+            std::array<float, 8> b;
+            for (size_t c = 0; c < 8; c++)
+            {
+                a[c] = _gx[h[c] & 15] * cx[c] + _gy[h[c] & 15] * cy[c];
+                b[c] = _gz[h[c] & 15];
+            }
+
+            // Branch free loop over the run, vectorized by the compiler
+            const float zf = zi;
+            for (size_t k = begin; k < end; k++)
+            {
+                const float zp = z[k] - zf;
+                const float zm = zp - 1.0;
+                const float v = fade(zp);
+
+                // Interpolate along X
+                const float x_ym_zm = lerp(a[0] + b[0] * zm, a[1] + b[1] * zm, t);
+                const float x_yp_zm = lerp(a[2] + b[2] * zm, a[3] + b[3] * zm, t);
+                const float x_ym_zp = lerp(a[4] + b[4] * zp, a[5] + b[5] * zp, t);
+                const float x_yp_zp = lerp(a[6] + b[6] * zp, a[7] + b[7] * zp, t);
+
+                // Interpolate along Y
+                const float y_zm = lerp(x_ym_zm, x_yp_zm, u);
+                const float y_zp = lerp(x_ym_zp, x_yp_zp, u);
+
+                // Interpolate along Z, map [-2, 2] to [0, 1]
+                out[k] = lerp(y_zm, y_zp, v) * 0.25 + 0.5;
+            }
+
+            // Next cube
+            begin = end;
+        }
+    }
 };
 }
 
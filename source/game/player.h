@@ -342,15 +342,17 @@ class player
         // Reserve space for collision cells
         reserve_memory();
 
-        // If resuming game
-        if (!state.is_new_game())
+        // Copy loaded stats, new games and missing sections keep the defaults
+        if (state.has_stats())
         {
-            // Copy loaded stats
             _stats.fill(state.get_stats(), state.get_energy(),
                         state.get_exp(), state.get_health(),
                         state.get_oxygen(), state.get_stat_points());
+        }
 
-            // Copy loaded inventory
+        // Copy loaded inventory
+        if (state.has_inventory())
+        {
             _inv.fill(state.get_inventory(), _stats.level());
         }
     }
@@ -762,14 +764,14 @@ class player
             // Detect if player has landed
             if (collide)
             {
-                // Check if we landed
-                const min::vec3<float> center = cell.first.get_center();
+                // Check if we landed on top of the box, boxes may span several cells
+                const float top = cell.first.get_max().y();
 
                 // Calculate minimum gap between player
-                constexpr float min_dist = cgrid::_player_dy + 0.475;
+                constexpr float min_dist = cgrid::_player_dy - 0.025;
 
                 // Compare distances
-                if (p.y() - center.y() >= min_dist)
+                if (p.y() - top >= min_dist)
                 {
                     landed = true;
                 }
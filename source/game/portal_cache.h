@@ -0,0 +1,314 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __PORTAL_CACHE__
+#define __PORTAL_CACHE__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <game/chunk_baseline.h>
+#include <game/chunk_codec.h>
+#include <game/file.h>
+#include <game/id.h>
+#include <game/mapped_file.h>
+#include <game/save_queue.h>
+#include <game/snapshot.h>
+#include <iomanip>
+#include <iostream>
+#include <min/serial.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+class portal_key
+{
+  private:
+    std::vector<uint8_t> _bytes;
+
+  public:
+    portal_key(const uint32_t type, const size_t grid_scale, const size_t chunk_size)
+    {
+        // Generator type and grid dimensions
+        min::write_le<uint32_t>(_bytes, type);
+        min::write_le<uint32_t>(_bytes, static_cast<uint32_t>(grid_scale));
+        min::write_le<uint32_t>(_bytes, static_cast<uint32_t>(chunk_size));
+    }
+    inline void add(const int coeff)
+    {
+        // Append a fractal coefficient
+        min::write_le<uint32_t>(_bytes, static_cast<uint32_t>(coeff));
+    }
+    inline const std::vector<uint8_t> &bytes() const
+    {
+        return _bytes;
+    }
+    static inline std::string file_name(const uint32_t hash)
+    {
+        // Entries are named by the key hash, the full key is stored inside
+        std::ostringstream name;
+        name << "bin/portal_" << std::hex << std::setw(8) << std::setfill('0') << hash << ".cache";
+
+        return name.str();
+    }
+    inline std::string file_name() const
+    {
+        return file_name(hash());
+    }
+    inline uint32_t hash() const
+    {
+        return snapshot::crc32(_bytes.data(), _bytes.size());
+    }
+};
+
+class portal_cache
+{
+  private:
+    static constexpr uint32_t _magic = snapshot_id("BDSP");
+    // Bump when generation changes so stale entries are regenerated
+    static constexpr uint32_t _version = 1;
+    static constexpr uint32_t _key_id = snapshot_id("PKEY");
+    static constexpr uint32_t _table_id = snapshot_id("CTAB");
+    static constexpr uint32_t _data_id = snapshot_id("CDAT");
+    static constexpr size_t _entry_size = sizeof(uint32_t) * 2;
+    // Entries are a few MB each, only keep the most recently used ones on disk
+    static constexpr size_t _capacity = 16;
+    const std::string _index_name;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    std::vector<size_t> _offset;
+    std::vector<size_t> _length;
+    mapped_file _map;
+    std::atomic<bool> _failed;
+    std::vector<uint32_t> _recent;
+
+    inline void load_index()
+    {
+        // Read the entry hashes, most recently used first, a missing index is empty
+        recover_file(_index_name);
+        std::ifstream file(_index_name, std::ios::in | std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return;
+        }
+
+        // Read the whole index
+        const size_t size = static_cast<size_t>(file.tellg());
+        std::vector<uint8_t> stream(size);
+        file.seekg(0, std::ios::beg);
+        file.read(reinterpret_cast<char *>(stream.data()), size);
+
+        // Unpack the hashes
+        size_t next = 0;
+        while (next + sizeof(uint32_t) <= size && _recent.size() < _capacity)
+        {
+            _recent.push_back(min::read_le<uint32_t>(stream, next));
+        }
+    }
+    inline void touch(const portal_key &key)
+    {
+        // Move the entry to the front of the index
+        const uint32_t hash = key.hash();
+        const auto it = std::find(_recent.begin(), _recent.end(), hash);
+        if (it != _recent.end())
+        {
+            _recent.erase(it);
+        }
+        _recent.insert(_recent.begin(), hash);
+
+        // Erase the least recently used entries, their writes finished before the last open
+        while (_recent.size() > _capacity)
+        {
+            erase_file(portal_key::file_name(_recent.back()));
+            _recent.pop_back();
+        }
+
+        // Write the index on the save thread after the entry
+        std::vector<uint8_t> stream;
+        stream.reserve(_recent.size() * sizeof(uint32_t));
+        for (const uint32_t h : _recent)
+        {
+            min::write_le<uint32_t>(stream, h);
+        }
+        save_queue::writer.replace(_index_name, std::move(stream));
+    }
+    inline bool read_sections(const portal_key &key)
+    {
+        // Read the section table
+        snapshot_reader reader;
+        if (!reader.open(_map.data(), _map.size(), _magic) || reader.version() != _version)
+        {
+            return false;
+        }
+
+        // Names are hashes, check the full key
+        const snapshot_section *const k = reader.find(_key_id, true);
+        const std::vector<uint8_t> &bytes = key.bytes();
+        if (!k || k->size != bytes.size() || !std::equal(bytes.begin(), bytes.end(), reader.data(*k)))
+        {
+            return false;
+        }
+
+        // Find the chunk table and verify all chunk data
+        const size_t chunks = _offset.size();
+        const snapshot_section *const table = reader.find(_table_id, true);
+        const snapshot_section *const chunk_data = reader.find(_data_id, true);
+        if (!table || !chunk_data || table->size != chunks * _entry_size)
+        {
+            return false;
+        }
+
+        // Read the chunk table, offsets are relative to the chunk data
+        const uint8_t *const t = reader.data(*table);
+        for (size_t i = 0; i < chunks; i++)
+        {
+            const size_t offset = snapshot::read_u32(t + i * _entry_size);
+            _length[i] = snapshot::read_u32(t + i * _entry_size + 4);
+            if (offset + _length[i] > chunk_data->size)
+            {
+                return false;
+            }
+            _offset[i] = chunk_data->offset + offset;
+        }
+
+        return true;
+    }
+
+  public:
+    portal_cache(const size_t grid_scale, const size_t chunk_size)
+        : _index_name("bin/portal.index"), _grid_scale(grid_scale), _chunk_size(chunk_size), _chunk_scale(grid_scale / chunk_size),
+          _offset(_chunk_scale * _chunk_scale * _chunk_scale, 0), _length(_offset.size(), 0), _failed(false)
+    {
+        // Load the use order of entries on disk
+        load_index();
+    }
+
+    inline void close()
+    {
+        _map.close();
+    }
+    inline bool is_open() const
+    {
+        return _map.is_open();
+    }
+    inline bool is_valid() const
+    {
+        // Did every chunk decode since the entry was opened
+        return !_failed;
+    }
+    inline bool load_chunk(const size_t chunk_key, std::vector<block_id> &grid, chunk_baseline &base)
+    {
+        // Function to get chunk rows, rows are contiguous along z
+        const size_t origin = chunk_baseline::chunk_origin(_grid_scale, _chunk_size, chunk_key);
+        const auto row = [this, &grid, origin](const size_t r) -> block_id * {
+            const size_t x = r / _chunk_size;
+            const size_t y = r % _chunk_size;
+            return &grid[origin + (x * _grid_scale + y) * _grid_scale];
+        };
+
+        // Decode the chunk straight from the mapped file, caller regenerates the chunk if it is bad
+        const uint8_t *const src = _map.data() + _offset[chunk_key];
+        if (!chunk_codec::decode(src, _length[chunk_key], row, _chunk_size * _chunk_size, _chunk_size))
+        {
+            std::cout << "portal_cache: could not decode chunk " << chunk_key << std::endl;
+            _failed = true;
+            return false;
+        }
+
+        // The encoded chunk is the baseline
+        base.set_chunk(chunk_key, src, _length[chunk_key]);
+
+        return true;
+    }
+    inline bool open(const portal_key &key)
+    {
+        // Finish pending writes and interrupted replaces, then map the entry, fails if missing
+        _failed = false;
+        save_queue::writer.wait();
+        recover_file(key.file_name());
+        if (!_map.open(key.file_name()))
+        {
+            return false;
+        }
+
+        // Check the entry belongs to this key, chunks are decoded as they are needed
+        if (!read_sections(key))
+        {
+            close();
+            return false;
+        }
+
+        // Entry was used
+        touch(key);
+
+        return true;
+    }
+    inline void store(const portal_key &key, const chunk_baseline &base)
+    {
+        // The baseline is already encoded by chunk
+        const size_t chunks = base.size();
+
+        // Size the file up front so it is written without reallocating
+        size_t data_size = 0;
+        for (size_t i = 0; i < chunks; i++)
+        {
+            data_size += base.chunk(i).size();
+        }
+        const std::vector<uint8_t> &bytes = key.bytes();
+        const size_t sections = snapshot::section_header_size * 3;
+        const size_t reserve = snapshot::header_size + sections + bytes.size() + chunks * _entry_size + data_size;
+
+        // Write the key
+        snapshot_writer writer(_magic, _version, reserve);
+        std::vector<uint8_t> &key_section = writer.begin(_key_id, 1);
+        key_section.insert(key_section.end(), bytes.begin(), bytes.end());
+        writer.end();
+
+        // Write the chunk table
+        std::vector<uint8_t> &table = writer.begin(_table_id, 1);
+        size_t offset = 0;
+        for (size_t i = 0; i < chunks; i++)
+        {
+            min::write_le<uint32_t>(table, static_cast<uint32_t>(offset));
+            min::write_le<uint32_t>(table, static_cast<uint32_t>(base.chunk(i).size()));
+            offset += base.chunk(i).size();
+        }
+        writer.end();
+
+        // Write every chunk
+        std::vector<uint8_t> &chunk_data = writer.begin(_data_id, 1);
+        for (size_t i = 0; i < chunks; i++)
+        {
+            chunk_data.insert(chunk_data.end(), base.chunk(i).begin(), base.chunk(i).end());
+        }
+        writer.end();
+
+        // Write the entry on the save thread
+        save_queue::writer.replace(key.file_name(), std::move(writer.finish()));
+
+        // Entry was used, evict old entries
+        touch(key);
+    }
+};
+}
+
+#endif
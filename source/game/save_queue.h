@@ -0,0 +1,149 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __SAVE_QUEUE__
+#define __SAVE_QUEUE__
+
+#include <condition_variable>
+#include <deque>
+#include <game/file.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace game
+{
+
+class save_job
+{
+  private:
+    std::string _file_name;
+    std::vector<uint8_t> _stream;
+    bool _append;
+
+  public:
+    save_job(const std::string &file_name, std::vector<uint8_t> &&stream, const bool append)
+        : _file_name(file_name), _stream(std::move(stream)), _append(append) {}
+
+    inline void write() const
+    {
+        if (_append)
+        {
+            append_file(_file_name, _stream);
+        }
+        else
+        {
+            replace_file(_file_name, _stream);
+        }
+    }
+};
+
+class save_thread
+{
+  private:
+    std::deque<save_job> _jobs;
+    std::mutex _lock;
+    std::condition_variable _more_data;
+    std::condition_variable _idle;
+    bool _busy;
+    bool _die;
+    std::thread _thread;
+
+    inline void work()
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        while (true)
+        {
+            // Sleep until there are files to write
+            _more_data.wait(lock, [this]() { return !_jobs.empty() || _die; });
+
+            // Finish all writes before quitting
+            if (_jobs.empty())
+            {
+                break;
+            }
+
+            // Take the oldest job, files are written in order
+            const save_job job = std::move(_jobs.front());
+            _jobs.pop_front();
+            _busy = true;
+
+            // Write without holding the lock
+            lock.unlock();
+            job.write();
+            lock.lock();
+
+            // Signal waiters when the queue drains
+            _busy = false;
+            if (_jobs.empty())
+            {
+                _idle.notify_all();
+            }
+        }
+    }
+
+  public:
+    save_thread() : _busy(false), _die(false), _thread(&save_thread::work, this) {}
+    ~save_thread()
+    {
+        // Signal the thread to quit after pending writes
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _die = true;
+        }
+        _more_data.notify_one();
+
+        // Wait for the thread to finish
+        _thread.join();
+    }
+    inline void append(const std::string &file_name, std::vector<uint8_t> &&stream)
+    {
+        push(file_name, std::move(stream), true);
+    }
+    inline void push(const std::string &file_name, std::vector<uint8_t> &&stream, const bool append)
+    {
+        // Queue the write, the stream is moved not copied
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _jobs.emplace_back(file_name, std::move(stream), append);
+        }
+        _more_data.notify_one();
+    }
+    inline void replace(const std::string &file_name, std::vector<uint8_t> &&stream)
+    {
+        push(file_name, std::move(stream), false);
+    }
+    inline void wait()
+    {
+        // Block until all queued files are on disk
+        std::unique_lock<std::mutex> lock(_lock);
+        _idle.wait(lock, [this]() { return _jobs.empty() && !_busy; });
+    }
+};
+
+// Global thread for writing save files
+class save_queue
+{
+  public:
+    static save_thread writer;
+};
+
+save_thread save_queue::writer;
+}
+
+#endif
@@ -0,0 +1,233 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __SNAPSHOT__
+#define __SNAPSHOT__
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace game
+{
+
+// Section ids are four characters packed little endian
+constexpr uint32_t snapshot_id(const char (&s)[5])
+{
+    return static_cast<uint32_t>(s[0]) | (static_cast<uint32_t>(s[1]) << 8) | (static_cast<uint32_t>(s[2]) << 16) | (static_cast<uint32_t>(s[3]) << 24);
+}
+
+class snapshot_section
+{
+  public:
+    uint32_t id;
+    uint32_t version;
+    size_t offset;
+    size_t size;
+    uint32_t crc;
+
+    snapshot_section(const uint32_t i, const uint32_t v, const size_t o, const size_t s, const uint32_t c)
+        : id(i), version(v), offset(o), size(s), crc(c) {}
+};
+
+class snapshot
+{
+  private:
+    static inline std::array<uint32_t, 256> crc_table()
+    {
+        // Reflected CRC-32 polynomial
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (size_t k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+
+        return table;
+    }
+
+  public:
+    static constexpr size_t header_size = sizeof(uint32_t) * 3;
+    static constexpr size_t section_header_size = sizeof(uint32_t) * 4;
+
+    static inline uint32_t crc32(const uint8_t *const data, const size_t size)
+    {
+        // Table is built once on first use
+        static const std::array<uint32_t, 256> table = crc_table();
+
+        uint32_t c = 0xFFFFFFFF;
+        for (size_t i = 0; i < size; i++)
+        {
+            c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+        }
+
+        return c ^ 0xFFFFFFFF;
+    }
+    static inline uint32_t read_u32(const uint8_t *const b)
+    {
+        // Read little endian from raw memory
+        return static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) | (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    }
+    static inline void write_u32(std::vector<uint8_t> &stream, const size_t at, const uint32_t value)
+    {
+        // Write little endian into reserved bytes
+        stream[at] = value & 0xFF;
+        stream[at + 1] = (value >> 8) & 0xFF;
+        stream[at + 2] = (value >> 16) & 0xFF;
+        stream[at + 3] = (value >> 24) & 0xFF;
+    }
+};
+
+class snapshot_writer
+{
+  private:
+    std::vector<uint8_t> _stream;
+    size_t _sections;
+    size_t _start;
+
+  public:
+    snapshot_writer(const uint32_t magic, const uint32_t version, const size_t reserve)
+        : _sections(0), _start(0)
+    {
+        // Write the file header, the section count is filled in later
+        _stream.reserve(reserve);
+        _stream.resize(snapshot::header_size);
+        snapshot::write_u32(_stream, 0, magic);
+        snapshot::write_u32(_stream, 4, version);
+    }
+    inline std::vector<uint8_t> &begin(const uint32_t id, const uint32_t version)
+    {
+        // Write the section header, length and crc are filled in by end()
+        _start = _stream.size();
+        _stream.resize(_start + snapshot::section_header_size);
+        snapshot::write_u32(_stream, _start, id);
+        snapshot::write_u32(_stream, _start + 4, version);
+
+        // Section data is appended to the stream
+        return _stream;
+    }
+    inline void end()
+    {
+        // Fill in the section length and crc
+        const size_t data = _start + snapshot::section_header_size;
+        const size_t size = _stream.size() - data;
+        snapshot::write_u32(_stream, _start + 8, static_cast<uint32_t>(size));
+        snapshot::write_u32(_stream, _start + 12, snapshot::crc32(&_stream[0] + data, size));
+        _sections++;
+    }
+    inline std::vector<uint8_t> &finish()
+    {
+        // Fill in the section count
+        snapshot::write_u32(_stream, 8, static_cast<uint32_t>(_sections));
+
+        return _stream;
+    }
+};
+
+class snapshot_reader
+{
+  private:
+    const uint8_t *_data;
+    size_t _size;
+    uint32_t _version;
+    size_t _end;
+    std::vector<snapshot_section> _sections;
+
+  public:
+    snapshot_reader() : _data(nullptr), _size(0), _version(0), _end(0) {}
+
+    inline const uint8_t *data(const snapshot_section &s) const
+    {
+        return _data + s.offset;
+    }
+    inline size_t end() const
+    {
+        return _end;
+    }
+    inline const snapshot_section *find(const uint32_t id, const bool verify) const
+    {
+        // Sections are few, linear search is fastest
+        for (const snapshot_section &s : _sections)
+        {
+            if (s.id == id)
+            {
+                // Large sections may be checked piecewise by the caller
+                if (verify && snapshot::crc32(_data + s.offset, s.size) != s.crc)
+                {
+                    return nullptr;
+                }
+
+                return &s;
+            }
+        }
+
+        return nullptr;
+    }
+    inline bool open(const uint8_t *const data, const size_t size, const uint32_t magic)
+    {
+        // Works on a loaded stream or a mapped file
+        _data = data;
+        _size = size;
+        _sections.clear();
+        if (!data || size < snapshot::header_size || snapshot::read_u32(data) != magic)
+        {
+            return false;
+        }
+
+        // Read the file header
+        _version = snapshot::read_u32(data + 4);
+        const uint32_t count = snapshot::read_u32(data + 8);
+
+        // Read the section table without touching section data
+        size_t next = snapshot::header_size;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (next + snapshot::section_header_size > size)
+            {
+                return false;
+            }
+            const uint8_t *const h = data + next;
+            const size_t offset = next + snapshot::section_header_size;
+            const size_t length = snapshot::read_u32(h + 8);
+            if (offset + length > size)
+            {
+                return false;
+            }
+
+            // Record the section
+            _sections.emplace_back(snapshot::read_u32(h), snapshot::read_u32(h + 4), offset, length, snapshot::read_u32(h + 12));
+            next = offset + length;
+        }
+
+        // Data after the last section belongs to the caller
+        _end = next;
+
+        return true;
+    }
+    inline uint32_t version() const
+    {
+        return _version;
+    }
+};
+}
+
+#endif
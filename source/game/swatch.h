@@ -18,32 +18,234 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __SWATCH__
 #define __SWATCH__
 
+#include <algorithm>
 #include <array>
+#include <cstdint>
 #include <game/id.h>
+#include <memory>
+#include <vector>
 
 namespace game
 {
 
+class swatch_page
+{
+  private:
+    std::vector<block_id> _palette;
+    std::vector<uint8_t> _data;
+    uint8_t _bits;
+
+    static inline uint8_t index_bits(const size_t colors)
+    {
+        // Bits per cell are a power of two so cells never straddle bytes
+        if (colors <= 1)
+        {
+            return 0;
+        }
+        else if (colors <= 2)
+        {
+            return 1;
+        }
+        else if (colors <= 4)
+        {
+            return 2;
+        }
+        else if (colors <= 16)
+        {
+            return 4;
+        }
+
+        return 8;
+    }
+    inline uint8_t palette_index(const block_id id) const
+    {
+        // Palettes are small, linear search is fastest
+        const size_t size = _palette.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (_palette[i] == id)
+            {
+                return static_cast<uint8_t>(i);
+            }
+        }
+
+        return 0;
+    }
+
+  public:
+    swatch_page(const block_id *const cells, const size_t size) : _bits(0)
+    {
+        // Collect the unique blocks in this page
+        for (size_t i = 0; i < size; i++)
+        {
+            if (std::find(_palette.begin(), _palette.end(), cells[i]) == _palette.end())
+            {
+                _palette.push_back(cells[i]);
+            }
+        }
+
+        // Uniform pages don't store any cell data
+        _bits = index_bits(_palette.size());
+        if (_bits > 0)
+        {
+            // Pack palette indices into bytes
+            const size_t per = 8 / _bits;
+            _data.resize((size + per - 1) / per, 0);
+            for (size_t i = 0; i < size; i++)
+            {
+                const uint8_t shift = (i % per) * _bits;
+                _data[i / per] |= palette_index(cells[i]) << shift;
+            }
+        }
+    }
+    inline block_id get(const size_t index) const
+    {
+        if (_bits == 0)
+        {
+            return _palette[0];
+        }
+
+        // Unpack the palette index for this cell
+        const size_t per = 8 / _bits;
+        const uint8_t shift = (index % per) * _bits;
+        const uint8_t mask = (1 << _bits) - 1;
+
+        return _palette[(_data[index / per] >> shift) & mask];
+    }
+    inline bool is_equal(const block_id *const cells, const size_t size) const
+    {
+        // Compare the page against raw cells
+        for (size_t i = 0; i < size; i++)
+        {
+            if (get(i) != cells[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
 class swatch
 {
   private:
-    static constexpr size_t _scale = 6;
-    static constexpr size_t _size = _scale * _scale * _scale;
-    std::vector<block_id> _b;
+    static constexpr size_t _page_scale = 8;
+    static constexpr size_t _page_size = _page_scale * _page_scale * _page_scale;
+    static constexpr size_t _scale = 64;
+    static constexpr size_t _pages = _scale / _page_scale;
+    static constexpr size_t _slice_size = _page_scale * _scale * _scale;
+    static constexpr size_t _no_slice = _pages;
+    std::vector<std::shared_ptr<const swatch_page>> _p;
+    std::vector<block_id> _slice;
+    size_t _slice_index;
+    mutable std::array<block_id, _scale> _row;
     min::vec3<unsigned> _length;
     min::vec3<int> _offset;
 
-    inline size_t grid_key_pack(const std::tuple<size_t, size_t, size_t> &t) const
+    static inline size_t page_key(const size_t pi, const size_t pj, const size_t pk)
+    {
+        return (pi * _pages * _pages) + (pj * _pages) + pk;
+    }
+    static inline size_t page_cell(const size_t i, const size_t j, const size_t k)
     {
-        return min::vec3<float>::grid_key(t, _scale);
+        // Cell index inside the page
+        const size_t ii = i % _page_scale;
+        const size_t jj = j % _page_scale;
+        const size_t kk = k % _page_scale;
+
+        return (ii * _page_scale * _page_scale) + (jj * _page_scale) + kk;
     }
-    inline std::tuple<size_t, size_t, size_t> grid_key_unpack(const size_t key) const
+    static inline size_t slice_cell(const size_t i, const size_t j, const size_t k)
     {
-        return min::vec3<float>::grid_index(key, _scale);
+        // Cell index inside the staged slice
+        return (((i % _page_scale) * _scale) + j) * _scale + k;
+    }
+    inline block_id page_get(const size_t i, const size_t j, const size_t k) const
+    {
+        // Missing pages are empty
+        const std::shared_ptr<const swatch_page> &page = _p[page_key(i / _page_scale, j / _page_scale, k / _page_scale)];
+        if (!page)
+        {
+            return block_id::EMPTY;
+        }
+
+        return page->get(page_cell(i, j, k));
+    }
+    inline void stage(const size_t slice)
+    {
+        // Encode the currently staged slice
+        flush();
+
+        // Decode the slice pages so untouched cells are kept
+        _slice.resize(_slice_size);
+        _slice_index = slice;
+        const size_t i0 = slice * _page_scale;
+        for (size_t i = 0; i < _page_scale; i++)
+        {
+            for (size_t j = 0; j < _scale; j++)
+            {
+                for (size_t k = 0; k < _scale; k++)
+                {
+                    _slice[slice_cell(i, j, k)] = page_get(i0 + i, j, k);
+                }
+            }
+        }
     }
 
   public:
-    swatch() : _b(_size, block_id::EMPTY) {}
+    swatch() : _p(_pages * _pages * _pages), _slice_index(_no_slice) {}
+    static constexpr size_t max_scale()
+    {
+        return _scale;
+    }
+    inline void flush()
+    {
+        if (_slice_index == _no_slice)
+        {
+            return;
+        }
+
+        // Compress each page of the staged slice
+        std::array<block_id, _page_size> cells;
+        for (size_t pj = 0; pj < _pages; pj++)
+        {
+            for (size_t pk = 0; pk < _pages; pk++)
+            {
+                // Gather page cells from the slice
+                const size_t j0 = pj * _page_scale;
+                const size_t k0 = pk * _page_scale;
+                bool empty = true;
+                for (size_t i = 0; i < _page_scale; i++)
+                {
+                    for (size_t j = 0; j < _page_scale; j++)
+                    {
+                        for (size_t k = 0; k < _page_scale; k++)
+                        {
+                            const block_id b = _slice[slice_cell(i, j0 + j, k0 + k)];
+                            cells[page_cell(i, j, k)] = b;
+                            empty = empty && (b == block_id::EMPTY);
+                        }
+                    }
+                }
+
+                // Keep shared pages that were not changed, drop empty pages
+                std::shared_ptr<const swatch_page> &page = _p[page_key(_slice_index, pj, pk)];
+                if (empty)
+                {
+                    page.reset();
+                }
+                else if (!page || !page->is_equal(cells.data(), _page_size))
+                {
+                    page = std::make_shared<const swatch_page>(cells.data(), _page_size);
+                }
+            }
+        }
+
+        // Release the staging memory
+        _slice_index = _no_slice;
+        std::vector<block_id>().swap(_slice);
+    }
     const min::vec3<unsigned> &get_length() const
     {
         return _length;
@@ -54,14 +256,42 @@ class swatch
     }
     block_id get(const size_t i, const size_t j, const size_t k) const
     {
-        return _b[grid_key_pack(std::make_tuple(i, j, k))];
+        // Read through the staged slice if writing
+        if (i / _page_scale == _slice_index)
+        {
+            return _slice[slice_cell(i, j, k)];
+        }
+
+        return page_get(i, j, k);
     }
-    void reset()
+    const block_id *read_row(const size_t i, const size_t j) const
+    {
+        // Decode the row along z axis
+        const size_t size = _length.z();
+        for (size_t k = 0; k < size; k++)
+        {
+            _row[k] = get(i, j, k);
+        }
+
+        return _row.data();
+    }
+    block_id *write_row(const size_t i, const size_t j)
     {
-        for (size_t i = 0; i < _size; i++)
+        // Writes are staged one x slice at a time, rows should be written in x order
+        const size_t slice = i / _page_scale;
+        if (slice != _slice_index)
         {
-            _b[i] = block_id::EMPTY;
+            stage(slice);
         }
+
+        return &_slice[slice_cell(i, j, 0)];
+    }
+    void reset()
+    {
+        // Drop all pages, other swatches sharing them are unaffected
+        _slice_index = _no_slice;
+        std::vector<block_id>().swap(_slice);
+        std::fill(_p.begin(), _p.end(), nullptr);
     }
     void set_length(const min::vec3<unsigned> &length)
     {
@@ -73,7 +303,57 @@ class swatch
     }
     void set(const size_t i, const size_t j, const size_t k, const block_id atlas)
     {
-        _b[grid_key_pack(std::make_tuple(i, j, k))] = atlas;
+        write_row(i, j)[k] = atlas;
+    }
+};
+
+class swatch_history
+{
+  private:
+    static constexpr size_t _size = 8;
+    std::array<swatch, _size> _ring;
+    std::array<unsigned, _size> _cost;
+    size_t _head;
+    size_t _count;
+    size_t _cursor;
+
+  public:
+    swatch_history() : _cost{}, _head(0), _count(0), _cursor(0) {}
+
+    inline void clear()
+    {
+        // Release all pages held by the history
+        for (swatch &sw : _ring)
+        {
+            sw.reset();
+        }
+        _head = 0;
+        _count = 0;
+        _cursor = 0;
+    }
+    inline bool empty() const
+    {
+        return _count == 0;
+    }
+    inline const swatch &prev(unsigned &cost)
+    {
+        // Step back through history, wrap around to the most recent
+        _cursor = (_cursor + 1) % _count;
+        const size_t index = (_head + _size - 1 - _cursor) % _size;
+        cost = _cost[index];
+
+        return _ring[index];
+    }
+    inline void push(const swatch &sw, const unsigned cost)
+    {
+        // Copying a swatch only shares its pages
+        _ring[_head] = sw;
+        _cost[_head] = cost;
+        _head = (_head + 1) % _size;
+        _count = (_count < _size) ? _count + 1 : _size;
+
+        // Start recalling from the newest entry
+        _cursor = 0;
     }
 };
 }
@@ -103,11 +103,13 @@ class terrain_mesher
             // Reserve space in parent mesh
             allocate_mesh_vbo(mesh);
 
-            // Convert faces to mesh
-            for (size_t i = 0; i < size; i++)
-            {
+            // Parallelize on generating faces
+            const auto work = [this, &mesh](std::mt19937 &gen, const size_t i) {
                 set_face(i, mesh);
-            }
+            };
+
+            // Convert faces to mesh in parallel
+            work_queue::worker.run(std::cref(work), 0, size);
         }
     }
     inline void reserve_memory(const size_t chunk_size) const
@@ -153,6 +155,10 @@ class terrain_mesher
     {
         _cells.clear();
     }
+    inline void append(const std::vector<min::vec4<float>> &cells) const
+    {
+        _cells.insert(_cells.end(), cells.begin(), cells.end());
+    }
     template <typename GB>
     inline void generate_chunk_faces(
         const min::vec3<float> &p,
@@ -272,10 +278,10 @@ class terrain_mesher
         }
     }
     template <typename GB>
-    inline void generate_chunk_faces_rotated(
-        const min::vec3<float> &p, const min::vec3<int> &offset,
+    static inline void generate_chunk_faces_rotated(
+        std::vector<min::vec4<float>> &cells, const min::vec3<float> &p, const min::vec3<int> &offset,
         const std::tuple<size_t, size_t, size_t> &index,
-        const std::tuple<size_t, size_t, size_t> &edge, const GB &get_block, const float float_atlas) const
+        const std::tuple<size_t, size_t, size_t> &edge, const GB &get_block, const float float_atlas)
     {
         const size_t ix = std::get<0>(index);
         const size_t iy = std::get<1>(index);
@@ -290,24 +296,24 @@ class terrain_mesher
             const block_id x1 = get_block(std::make_tuple(ix - 1, iy, iz));
             if (x1 == block_id::EMPTY)
             {
-                _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 0.1));
+                cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 0.1));
             }
         }
         else if ((on_edge_nx && offset.x() > 0) || (on_edge_px && offset.x() < 0))
         {
-            _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 0.1));
+            cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 0.1));
         }
         if (!on_edge_nx && !on_edge_px)
         {
             const block_id x2 = get_block(std::make_tuple(ix + 1, iy, iz));
             if (x2 == block_id::EMPTY)
             {
-                _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 255.1));
+                cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 255.1));
             }
         }
         else if ((on_edge_nx && offset.x() < 0) || (on_edge_px && offset.x() > 0))
         {
-            _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 255.1));
+            cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 255.1));
         }
 
         // Generate Y Faces
@@ -319,24 +325,24 @@ class terrain_mesher
             const block_id y1 = get_block(std::make_tuple(ix, iy - 1, iz));
             if (y1 == block_id::EMPTY)
             {
-                _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 510.1));
+                cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 510.1));
             }
         }
         else if ((on_edge_ny && offset.y() > 0) || (on_edge_py && offset.y() < 0))
         {
-            _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 510.1));
+            cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 510.1));
         }
         if (!on_edge_ny && !on_edge_py)
         {
             const block_id y2 = get_block(std::make_tuple(ix, iy + 1, iz));
             if (y2 == block_id::EMPTY)
             {
-                _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 765.1));
+                cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 765.1));
             }
         }
         else if ((on_edge_ny && offset.y() < 0) || (on_edge_py && offset.y() > 0))
         {
-            _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 765.1));
+            cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 765.1));
         }
 
         // Generate Z Faces
@@ -348,24 +354,24 @@ class terrain_mesher
             const block_id z1 = get_block(std::make_tuple(ix, iy, iz - 1));
             if (z1 == block_id::EMPTY)
             {
-                _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1020.1));
+                cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1020.1));
             }
         }
         else if ((on_edge_nz && offset.z() > 0) || (on_edge_pz && offset.z() < 0))
         {
-            _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1020.1));
+            cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1020.1));
         }
         if (!on_edge_nz && !on_edge_pz)
         {
             const block_id z2 = get_block(std::make_tuple(ix, iy, iz + 1));
             if (z2 == block_id::EMPTY)
             {
-                _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1275.1));
+                cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1275.1));
             }
         }
         else if ((on_edge_nz && offset.z() < 0) || (on_edge_pz && offset.z() > 0))
         {
-            _cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1275.1));
+            cells.push_back(min::vec4<float>(p.x(), p.y(), p.z(), float_atlas + 1275.1));
         }
     }
     inline void generate_chunk(min::mesh<float, uint32_t> &mesh) const
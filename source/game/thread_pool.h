@@ -226,9 +226,11 @@ class thread_pool
     }
 
   public:
-    thread_pool() : _thread_count(std::thread::hardware_concurrency()),
-                    _threads(_thread_count - 1), _die(false), _turbo(false),
-                    _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+    thread_pool() : thread_pool(std::thread::hardware_concurrency()) {}
+    thread_pool(const unsigned thread_count)
+        : _thread_count(thread_count),
+          _threads(_thread_count - 1), _die(false), _turbo(false),
+          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
     {
         // Error out if can't determine core count
         if (_thread_count < 1)
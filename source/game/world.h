@@ -90,6 +90,7 @@ class world
     bool _edit_mode;
     block_id _atlas_id;
     swatch _swatch;
+    swatch_history _history;
     unsigned _swatch_cost;
     bool _swatch_mode;
     bool _swatch_copy_place;
@@ -267,8 +268,8 @@ class world
         // Create the physics body
         _char_id = _simulation.add_body(cgrid::player_box(spawn), 10.0);
 
-        // Update recent chunk
-        _grid.update_current_chunk(spawn);
+        // Generate and mesh chunks around the spawn point first
+        _grid.page_spawn(spawn);
 
         // Remove 3x3 blocks if new game
         if (new_game)
@@ -508,6 +509,16 @@ class world
         // Didn't hit anything
         return block_id::EMPTY;
     }
+    inline size_t max_scale() const
+    {
+        // Swatches can be larger than placed blocks
+        if (_swatch_mode)
+        {
+            return swatch::max_scale();
+        }
+
+        return _pre_max_scale;
+    }
     // Generates the preview geometry and adds it to preview buffer
     inline void generate_preview()
     {
@@ -658,6 +669,9 @@ class world
     }
     inline min::vec3<float> ray_spawn(const min::vec3<float> &p)
     {
+        // Generate the chunks under this point before tracing
+        _grid.page_column(p);
+
         // Create a ray point down
         const min::ray<float, min::vec3> r(p, p - min::vec3<float>::up());
 
@@ -823,8 +837,12 @@ class world
         const float x = _grid_dist(_gen);
         const float y = _state.get_top().y() - _spawn_limit;
         const float z = _grid_dist(_gen);
+        const min::vec3<float> p(x, y, z);
 
-        return min::vec3<float>(x, y, z);
+        // Generate the chunks under this point so it doesn't spawn inside ungenerated stone
+        _grid.page_column(p);
+
+        return p;
     }
     inline min::vec3<float> spawn_random()
     {
@@ -862,8 +880,9 @@ class world
         const min::vec3<float> &p = _player.position();
         const uint_fast16_t player_level = _player.get_stats().level();
 
-        // Send drones after the player
+        // Send drones after the player, path searches get a fixed budget per frame
         _drones.set_destination(p);
+        _drones.reset_path_budget();
 
         // Solve all physics timesteps
         for (size_t i = 0; i < steps; i++)
@@ -909,7 +928,7 @@ class world
   public:
     world(const options &opt, particle &particles, sound &s, const uniforms &uniforms)
         : _state(opt),
-          _grid(opt.chunk(), opt.grid(), opt.view()),
+          _grid(opt.chunk(), opt.grid(), opt.view(), _state.get_world_seed()),
           _terrain(uniforms, _grid.get_chunks(), opt.chunk()),
           _particles(&particles),
           _sound(&s),
@@ -963,7 +982,7 @@ class world
         _state = load_state(opt);
 
         // Reload grid
-        _grid.reset();
+        _grid.reset(_state.get_world_seed());
 
         // Reset to default
         _cached_offset = min::vec3<int>(1, 1, 1);
@@ -974,6 +993,7 @@ class world
         _swatch_cost = 0;
         _swatch_mode = false;
         _swatch_copy_place = false;
+        _history.clear();
 
         // Reset instances
         _chests.reset();
@@ -1211,6 +1231,12 @@ class world
         // Load data into swatch
         _swatch_cost = _grid.load_swatch(_swatch, _preview, _preview_offset, _scale);
 
+        // Remember copies larger than a single block, shares swatch pages
+        if (_scale.x() * _scale.y() * _scale.z() > 1)
+        {
+            _history.push(_swatch, _swatch_cost);
+        }
+
         // Generate new preview
         generate_preview();
     }
@@ -1225,6 +1251,9 @@ class world
         // Spawn character position
         const min::vec3<float> spawn = ray_spawn(p);
 
+        // Generate and mesh chunks around the spawn point first, the rest are paged in while playing
+        _grid.page_spawn(spawn);
+
         // Warp player
         _player.set_position(spawn);
 
@@ -1240,6 +1269,22 @@ class world
         // Update chunks
         update_all_chunks();
     }
+    inline void prev_swatch()
+    {
+        // Only applicable when placing swatches
+        if (_edit_mode && _swatch_mode && !_history.empty())
+        {
+            // Recall an older swatch from history
+            _swatch = _history.prev(_swatch_cost);
+            _scale = _swatch.get_length();
+
+            // Switch to place mode
+            _swatch_copy_place = false;
+
+            // Generate new preview
+            generate_preview();
+        }
+    }
     inline void random_item()
     {
         _player.get_inventory().random_item();
@@ -1250,7 +1295,11 @@ class world
         _player.respawn(_state);
 
         // Spawn character position
-        _player.set_position(ray_spawn(_state.get_default_spawn()));
+        const min::vec3<float> spawn = ray_spawn(_state.get_default_spawn());
+
+        // Generate chunks around the spawn point
+        _grid.page_spawn(spawn);
+        _player.set_position(spawn);
 
         // Zero out character velocity
         _player.velocity(min::vec3<float>());
@@ -1281,6 +1330,7 @@ class world
     {
         // Set the state
         _state.set_state(_player.position(), cam, _player.get_inventory(), _player.get_stats(), _instance);
+        _state.set_world_seed(_grid.get_world_seed());
 
         // Save the state
         _state.save_state();
@@ -1398,7 +1448,7 @@ class world
                 // Regenerate the preview mesh
                 generate_preview();
             }
-            else if (_scale.x() < _pre_max_scale)
+            else if (_scale.x() < max_scale())
             {
                 _scale.x(_scale.x() + dx);
 
@@ -1417,7 +1467,7 @@ class world
                 // Regenerate the preview mesh
                 generate_preview();
             }
-            else if (_scale.y() < _pre_max_scale)
+            else if (_scale.y() < max_scale())
             {
                 _scale.y(_scale.y() + dy);
 
@@ -1436,7 +1486,7 @@ class world
                 // Regenerate the preview mesh
                 generate_preview();
             }
-            else if (_scale.z() < _pre_max_scale)
+            else if (_scale.z() < max_scale())
             {
                 _scale.z(_scale.z() + dz);
 
@@ -1489,6 +1539,9 @@ class world
         // Detect if we crossed a chunk boundary
         _grid.update_current_chunk(p);
 
+        // Read chunks around the player from the world file
+        _grid.page_chunks();
+
         // Get surrounding chunks for drawing
         _grid.update_view_chunk_index(cam, _view_chunk_index);
 
@@ -0,0 +1,517 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __WORLD_FILE__
+#define __WORLD_FILE__
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <game/chunk_baseline.h>
+#include <game/chunk_codec.h>
+#include <game/file.h>
+#include <game/id.h>
+#include <game/mapped_file.h>
+#include <game/save_queue.h>
+#include <game/snapshot.h>
+#include <game/work_queue.h>
+#include <game/world_seed.h>
+#include <iostream>
+#include <min/serial.h>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+class world_file
+{
+  private:
+    static constexpr uint32_t _magic = snapshot_id("BDSW");
+    // Bump when world generation changes, chunks are stored relative to the generated world
+    static constexpr uint32_t _version = 8;
+    static constexpr uint32_t _grid_id = snapshot_id("GRID");
+    static constexpr uint32_t _seed_id = snapshot_id("SEED");
+    static constexpr uint32_t _table_id = snapshot_id("CTAB");
+    static constexpr uint32_t _data_id = snapshot_id("CDAT");
+    static constexpr size_t _entry_size = sizeof(uint32_t) * 3;
+    static constexpr size_t _record_size = sizeof(uint32_t) * 3;
+    static constexpr size_t _batch = 64;
+    const std::string _file_name;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
+    std::vector<uint32_t> _saved;
+    std::vector<uint8_t> _stream;
+    std::vector<std::vector<uint8_t>> _encoded;
+    std::vector<uint32_t> _encoded_crc;
+    std::vector<size_t> _keys;
+    mapped_file _map;
+    std::vector<size_t> _offset;
+    std::vector<size_t> _length;
+    std::vector<uint32_t> _crc;
+    size_t _snapshot_bytes;
+    size_t _tail_bytes;
+    world_seed _seed;
+    bool _reopen;
+
+    inline void encode_chunks(const std::vector<block_id> &grid, const chunk_baseline &base)
+    {
+        // Encode batches of chunks in parallel, one codec per batch, chunks are stored by chunk key
+        const size_t size = _keys.size();
+        const size_t batches = (size + _batch - 1) / _batch;
+        const auto work = [this, &grid, &base, size](std::mt19937 &, const size_t b) {
+            chunk_codec codec;
+            std::vector<block_id> delta(_chunk_size);
+            std::vector<block_id> before;
+            const size_t end = std::min((b + 1) * _batch, size);
+            for (size_t i = b * _batch; i < end; i++)
+            {
+                // Unpack the generated chunk
+                const size_t key = _keys[i];
+                base.decode(key, before);
+
+                // Function to get chunk rows as the difference from the baseline
+                const size_t origin = chunk_baseline::chunk_origin(_grid_scale, _chunk_size, key);
+                const auto row = [this, &grid, &before, &delta, origin](const size_t r) -> const block_id * {
+                    const size_t x = r / _chunk_size;
+                    const size_t y = r % _chunk_size;
+                    const size_t start = origin + (x * _grid_scale + y) * _grid_scale;
+                    const block_id *const old = &before[r * _chunk_size];
+                    for (size_t k = 0; k < _chunk_size; k++)
+                    {
+                        // Cells matching the baseline are INVALID
+                        const block_id cell = grid[start + k];
+                        delta[k] = (cell == old[k]) ? block_id::INVALID : cell;
+                    }
+
+                    return delta.data();
+                };
+
+                // Encode this chunk, untouched chunks are not stored
+                std::vector<uint8_t> &out = _encoded[key];
+                out.clear();
+                codec.encode(out, row, _chunk_size * _chunk_size, _chunk_size);
+                if (out.size() == 2 && out[1] == static_cast<uint8_t>(static_cast<int8_t>(block_id::INVALID)))
+                {
+                    out.clear();
+                }
+
+                // Checksum each chunk so it can be verified when paged in
+                _encoded_crc[key] = snapshot::crc32(out.data(), out.size());
+            }
+        };
+
+        // Run the batches on the worker threads
+        work_queue::worker.run(std::cref(work), 0, batches);
+    }
+    inline bool load_legacy(std::vector<block_id> &grid)
+    {
+        // Old saves are the raw grid as a single vector
+        size_t next = 0;
+        const uint32_t size = min::read_le<uint32_t>(_stream, next);
+        if (size != grid.size() || _stream.size() != next + size)
+        {
+            return false;
+        }
+
+        // Copy grid from file
+        for (size_t i = 0; i < size; i++)
+        {
+            grid[i] = static_cast<block_id>(static_cast<int8_t>(_stream[next + i]));
+        }
+
+        // Rewritten in the chunked format on next save
+        return true;
+    }
+    inline bool map_file(const world_seed &seed)
+    {
+        // Finish pending writes and interrupted replaces, then map the file, fails if missing
+        save_queue::writer.wait();
+        recover_file(_file_name);
+        _snapshot_bytes = 0;
+        _tail_bytes = 0;
+        if (!_map.open(_file_name))
+        {
+            return false;
+        }
+
+        // Read the snapshot sections
+        size_t snapshot = 0;
+        if (!read_sections(seed, snapshot))
+        {
+            close();
+            return false;
+        }
+
+        // Later records in the log replace snapshot chunks
+        const uint8_t *const data = _map.data();
+        const size_t size = _map.size();
+        const size_t chunks = _offset.size();
+        size_t next = snapshot;
+        while (next + _record_size <= size)
+        {
+            const uint32_t chunk_key = snapshot::read_u32(data + next);
+            const uint32_t length = snapshot::read_u32(data + next + 4);
+            const size_t start = next + _record_size;
+            if (chunk_key >= chunks || start + length > size)
+            {
+                break;
+            }
+
+            // Point chunk at the newest record
+            _offset[chunk_key] = start;
+            _length[chunk_key] = length;
+            _crc[chunk_key] = snapshot::read_u32(data + next + 8);
+            next = start + length;
+        }
+
+        // A torn record at the end would swallow later appends, rewrite the whole file on the next save
+        _snapshot_bytes = snapshot;
+        _tail_bytes = next - snapshot;
+        if (next != size)
+        {
+            std::cout << "world_file: ignoring torn record at the end of '" << _file_name << "'" << std::endl;
+            _snapshot_bytes = 0;
+        }
+
+        return true;
+    }
+    inline bool read_sections(const world_seed &seed, size_t &end)
+    {
+        // Read the section table, chunk data isn't touched
+        snapshot_reader reader;
+        const uint8_t *const data = _map.data();
+        const size_t size = _map.size();
+        if (!reader.open(data, size, _magic) || reader.version() != _version)
+        {
+            return false;
+        }
+
+        // Check that the grid dimensions match
+        const snapshot_section *const grid = reader.find(_grid_id, true);
+        if (!grid || grid->size != sizeof(uint32_t) * 2)
+        {
+            return false;
+        }
+        const uint8_t *const g = reader.data(*grid);
+        if (snapshot::read_u32(g) != _grid_scale || snapshot::read_u32(g + 4) != _chunk_size)
+        {
+            std::cout << "world_file: '" << _file_name << "' has a different grid size" << std::endl;
+            return false;
+        }
+
+        // Chunks are stored relative to the world generated from this seed
+        const snapshot_section *const sd = reader.find(_seed_id, true);
+        if (!sd || sd->size != sizeof(uint32_t) * 2)
+        {
+            return false;
+        }
+        const uint8_t *const sp = reader.data(*sd);
+        const world_seed file_seed(snapshot::read_u32(sp), snapshot::read_u32(sp + 4) != 0);
+        if (file_seed != seed)
+        {
+            std::cout << "world_file: '" << _file_name << "' was saved for a different world seed" << std::endl;
+            return false;
+        }
+
+        // Find the chunk table and chunk data, data is checked per chunk
+        const size_t chunks = _offset.size();
+        const snapshot_section *const table = reader.find(_table_id, true);
+        const snapshot_section *const chunk_data = reader.find(_data_id, false);
+        if (!table || !chunk_data || table->size != chunks * _entry_size)
+        {
+            return false;
+        }
+
+        // Read the chunk table, offsets are relative to the chunk data
+        const uint8_t *const t = reader.data(*table);
+        for (size_t i = 0; i < chunks; i++)
+        {
+            const uint8_t *const entry = t + i * _entry_size;
+            const size_t offset = snapshot::read_u32(entry);
+            _length[i] = snapshot::read_u32(entry + 4);
+            _crc[i] = snapshot::read_u32(entry + 8);
+            if (offset + _length[i] > chunk_data->size)
+            {
+                return false;
+            }
+            _offset[i] = chunk_data->offset + offset;
+        }
+
+        // The log starts after the last section
+        end = reader.end();
+
+        return true;
+    }
+
+  public:
+    world_file(const std::string &file_name, const size_t grid_scale, const size_t chunk_size)
+        : _file_name(file_name), _grid_scale(grid_scale), _chunk_size(chunk_size),
+          _chunk_scale(grid_scale / chunk_size),
+          _saved(_chunk_scale * _chunk_scale * _chunk_scale, 0),
+          _encoded(_saved.size()), _encoded_crc(_saved.size(), 0),
+          _offset(_saved.size(), 0), _length(_saved.size(), 0), _crc(_saved.size(), 0),
+          _snapshot_bytes(0), _tail_bytes(0), _reopen(false)
+    {
+        // Reserve space for encoding all chunks
+        _keys.reserve(_saved.size());
+    }
+    inline void close()
+    {
+        _map.close();
+        _reopen = false;
+    }
+    inline bool is_legacy() const
+    {
+        // Old saves are the raw grid after its size
+        std::ifstream file(_file_name, std::ios::binary | std::ios::ate);
+        const size_t cells = _grid_scale * _grid_scale * _grid_scale;
+
+        return file && static_cast<size_t>(file.tellg()) == sizeof(uint32_t) + cells;
+    }
+    inline bool is_open() const
+    {
+        return _map.is_open();
+    }
+    inline bool load(std::vector<block_id> &grid, const std::vector<uint32_t> &gen, const world_seed &seed)
+    {
+        // Apply every chunk straight from the mapped file in parallel
+        if (open(gen, seed))
+        {
+            const auto work = [this, &grid](std::mt19937 &, const size_t i) {
+                load_chunk(grid, i);
+            };
+            work_queue::worker.run(std::cref(work), 0, _offset.size());
+
+            // Release the mapping
+            close();
+
+            return true;
+        }
+
+        // Load data into stream from file
+        _stream.clear();
+        load_file(_file_name, _stream);
+
+        // Try to read an old save
+        bool loaded = false;
+        if (_stream.size() >= sizeof(uint32_t))
+        {
+            loaded = load_legacy(grid);
+            _saved = gen;
+            _seed = seed;
+        }
+
+        // Release stream memory
+        std::vector<uint8_t>().swap(_stream);
+
+        return loaded;
+    }
+    inline void load_chunk(std::vector<block_id> &grid, const size_t chunk_key) const
+    {
+        // Untouched chunks are already the baseline
+        const size_t length = _length[chunk_key];
+        if (length == 0)
+        {
+            return;
+        }
+
+        // Corrupt chunks keep the baseline
+        const uint8_t *const src = _map.data() + _offset[chunk_key];
+        if (snapshot::crc32(src, length) != _crc[chunk_key])
+        {
+            std::cout << "world_file: corrupt chunk " << chunk_key << " in '" << _file_name << "'" << std::endl;
+            return;
+        }
+
+        // Function to get chunk rows, rows are contiguous along z
+        const size_t origin = chunk_baseline::chunk_origin(_grid_scale, _chunk_size, chunk_key);
+        const auto row = [this, &grid, origin](const size_t r) -> block_id * {
+            const size_t x = r / _chunk_size;
+            const size_t y = r % _chunk_size;
+            return &grid[origin + (x * _grid_scale + y) * _grid_scale];
+        };
+
+        // Apply the newest record of this chunk on top of the baseline
+        if (!chunk_codec::decode(src, length, row, _chunk_size * _chunk_size, _chunk_size))
+        {
+            std::cout << "world_file: could not decode chunk " << chunk_key << " in '" << _file_name << "'" << std::endl;
+        }
+    }
+    inline bool open(const std::vector<uint32_t> &gen, const world_seed &seed)
+    {
+        // Map the file, fails if missing
+        if (!map_file(seed))
+        {
+            return false;
+        }
+
+        // The newest generation is now on disk
+        _saved = gen;
+        _seed = seed;
+
+        return true;
+    }
+    inline void reopen()
+    {
+        // A save released the mapping, chunks that aren't generated yet still need their saved records
+        if (_reopen)
+        {
+            _reopen = false;
+            map_file(_seed);
+        }
+    }
+    inline void save(const std::vector<block_id> &grid, const chunk_baseline &base,
+                     const std::vector<uint32_t> &gen, const world_seed &seed, const std::vector<bool> &paged)
+    {
+        // Records of chunks that aren't generated yet are read from the last save
+        reopen();
+
+        // Find generated chunks modified since the last save, the rest of the grid is only a fence
+        const size_t chunks = _saved.size();
+        _keys.clear();
+        for (size_t i = 0; i < chunks; i++)
+        {
+            if (gen[i] != _saved[i] && paged[i])
+            {
+                _keys.push_back(i);
+            }
+        }
+
+        // Encode the modified chunks, a compacted file reuses them
+        _stream.clear();
+        encode_chunks(grid, base);
+        size_t bytes = 0;
+        const size_t size = _keys.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            bytes += _record_size + _encoded[_keys[i]].size();
+        }
+
+        // Compact the log when it outgrows the snapshot or the world was regenerated
+        if (_snapshot_bytes == 0 || _tail_bytes + bytes > _snapshot_bytes || seed != _seed)
+        {
+            // Unmodified chunks keep their saved record, ungenerated chunks of a new world are the baseline
+            const bool mapped = _map.is_open() && seed == _seed;
+            size_t m = 0;
+            for (size_t i = 0; i < chunks; i++)
+            {
+                if (m < size && _keys[m] == i)
+                {
+                    m++;
+                }
+                else if (mapped)
+                {
+                    const uint8_t *const src = _map.data() + _offset[i];
+                    _encoded[i].assign(src, src + _length[i]);
+                    _encoded_crc[i] = _crc[i];
+                }
+                else if (paged[i])
+                {
+                    _keys.push_back(i);
+                }
+                else
+                {
+                    _encoded[i].clear();
+                    _encoded_crc[i] = snapshot::crc32(_encoded[i].data(), 0);
+                }
+            }
+            _keys.erase(_keys.begin(), _keys.begin() + size);
+            encode_chunks(grid, base);
+
+            // Size the file up front so it is written without reallocating
+            size_t data_size = 0;
+            for (size_t i = 0; i < chunks; i++)
+            {
+                data_size += _encoded[i].size();
+            }
+            const size_t sections = snapshot::section_header_size * 4 + sizeof(uint32_t) * 4;
+            const size_t reserve = snapshot::header_size + sections + chunks * _entry_size + data_size;
+
+            // Write the grid dimensions and world seed
+            snapshot_writer writer(_magic, _version, reserve);
+            std::vector<uint8_t> &grid_section = writer.begin(_grid_id, 1);
+            min::write_le<uint32_t>(grid_section, static_cast<uint32_t>(_grid_scale));
+            min::write_le<uint32_t>(grid_section, static_cast<uint32_t>(_chunk_size));
+            writer.end();
+            std::vector<uint8_t> &seed_section = writer.begin(_seed_id, 1);
+            min::write_le<uint32_t>(seed_section, seed.seed());
+            min::write_le<uint32_t>(seed_section, seed.is_portal() ? 1 : 0);
+            writer.end();
+
+            // Write the chunk table
+            std::vector<uint8_t> &table = writer.begin(_table_id, 1);
+            size_t offset = 0;
+            for (size_t i = 0; i < chunks; i++)
+            {
+                min::write_le<uint32_t>(table, static_cast<uint32_t>(offset));
+                min::write_le<uint32_t>(table, static_cast<uint32_t>(_encoded[i].size()));
+                min::write_le<uint32_t>(table, _encoded_crc[i]);
+                offset += _encoded[i].size();
+            }
+            writer.end();
+
+            // Write every chunk
+            std::vector<uint8_t> &chunk_data = writer.begin(_data_id, 1);
+            for (size_t i = 0; i < chunks; i++)
+            {
+                chunk_data.insert(chunk_data.end(), _encoded[i].begin(), _encoded[i].end());
+            }
+            writer.end();
+
+            // Release the mapping before writing the file, it is mapped again when more chunks are paged
+            _reopen = _map.is_open();
+            _map.close();
+
+            // Replace the old log on the save thread
+            std::vector<uint8_t> &stream = writer.finish();
+            _snapshot_bytes = stream.size();
+            _tail_bytes = 0;
+            _seed = seed;
+            save_queue::writer.replace(_file_name, std::move(stream));
+        }
+        else if (size > 0)
+        {
+            // Write only modified chunks
+            _stream.reserve(bytes);
+            for (size_t i = 0; i < size; i++)
+            {
+                const size_t key = _keys[i];
+                min::write_le<uint32_t>(_stream, static_cast<uint32_t>(key));
+                min::write_le<uint32_t>(_stream, static_cast<uint32_t>(_encoded[key].size()));
+                min::write_le<uint32_t>(_stream, _encoded_crc[key]);
+                _stream.insert(_stream.end(), _encoded[key].begin(), _encoded[key].end());
+            }
+            _tail_bytes += bytes;
+
+            // Release the mapping before writing the file, it is mapped again when more chunks are paged
+            _reopen = _map.is_open();
+            _map.close();
+
+            // Append to the log on the save thread
+            save_queue::writer.append(_file_name, std::move(_stream));
+        }
+
+        // Remember what was written
+        _saved = gen;
+        _stream.clear();
+    }
+};
+}
+
+#endif
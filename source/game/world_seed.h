@@ -0,0 +1,58 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __WORLD_SEED__
+#define __WORLD_SEED__
+
+#include <chrono>
+#include <cstdint>
+
+namespace game
+{
+
+class world_seed
+{
+  private:
+    uint32_t _seed;
+    bool _portal;
+
+  public:
+    world_seed()
+        : _seed(static_cast<uint32_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count())),
+          _portal(false) {}
+    world_seed(const uint32_t seed, const bool portal) : _seed(seed), _portal(portal) {}
+
+    inline bool operator==(const world_seed &other) const
+    {
+        return _seed == other._seed && _portal == other._portal;
+    }
+    inline bool operator!=(const world_seed &other) const
+    {
+        return !(*this == other);
+    }
+    inline bool is_portal() const
+    {
+        return _portal;
+    }
+    inline uint32_t seed() const
+    {
+        return _seed;
+    }
+};
+}
+
+#endif
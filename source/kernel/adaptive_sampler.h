@@ -0,0 +1,235 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __ADAPTIVE_SAMPLER__
+#define __ADAPTIVE_SAMPLER__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <iostream>
+#include <vector>
+
+namespace kernel
+{
+
+class adaptive_sampler
+{
+  private:
+    static constexpr size_t _block = 8;
+    static constexpr size_t _lattice = 27;
+    const size_t _scale;
+    std::vector<game::block_id> &_cells;
+
+    inline size_t key(const size_t x, const size_t y, const size_t z) const
+    {
+        return x * _scale * _scale + y * _scale + z;
+    }
+    template <typename E>
+    inline void sample(const E &eval, const size_t *const keys, const size_t count)
+    {
+        // Evaluate the cells that are not known yet
+        std::array<size_t, _lattice> todo;
+        std::array<game::block_id, _lattice> out;
+        size_t n = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+            if (_cells[keys[k]] == game::block_id::INVALID)
+            {
+                todo[n++] = keys[k];
+            }
+        }
+        if (n > 0)
+        {
+            eval(todo.data(), n, out.data());
+            for (size_t k = 0; k < n; k++)
+            {
+                _cells[todo[k]] = out[k];
+            }
+        }
+    }
+    inline void fill(const size_t x0, const size_t y0, const size_t z0,
+                     const size_t nx, const size_t ny, const size_t nz, const game::block_id id)
+    {
+        // Flood fill a uniform box, rows along z are contiguous
+        for (size_t x = x0; x < x0 + nx; x++)
+        {
+            for (size_t y = y0; y < y0 + ny; y++)
+            {
+                const size_t start = key(x, y, z0);
+                std::fill(_cells.begin() + start, _cells.begin() + start + nz, id);
+            }
+        }
+    }
+    template <typename E>
+    void box(const E &eval, const size_t x, const size_t y, const size_t z,
+             const size_t nx, const size_t ny, const size_t nz)
+    {
+        // Sample in place, INVALID marks cells not evaluated yet
+        fill(x, y, z, nx, ny, nz, game::block_id::INVALID);
+
+        // Coarse blocks start at the box origin and are clamped to the box
+        const size_t block = _block;
+        for (size_t x0 = x; x0 < x + nx; x0 += block)
+        {
+            for (size_t y0 = y; y0 < y + ny; y0 += block)
+            {
+                for (size_t z0 = z; z0 < z + nz; z0 += block)
+                {
+                    const size_t bx = std::min(block, x + nx - x0);
+                    const size_t by = std::min(block, y + ny - y0);
+                    const size_t bz = std::min(block, z + nz - z0);
+
+                    // Subdivide where the samples disagree
+                    node(eval, x0, y0, z0, bx, by, bz);
+                }
+            }
+        }
+    }
+    template <typename E>
+    void node(const E &eval, const size_t x0, const size_t y0, const size_t z0,
+              const size_t nx, const size_t ny, const size_t nz)
+    {
+        // Small boxes are evaluated exhaustively
+        std::array<size_t, _lattice> keys;
+        if (nx <= 2 && ny <= 2 && nz <= 2)
+        {
+            size_t count = 0;
+            for (size_t x = x0; x < x0 + nx; x++)
+            {
+                for (size_t y = y0; y < y0 + ny; y++)
+                {
+                    for (size_t z = z0; z < z0 + nz; z++)
+                    {
+                        keys[count++] = key(x, y, z);
+                    }
+                }
+            }
+            sample(eval, keys.data(), count);
+            return;
+        }
+
+        // Sample corners, edge midpoints, face centers and the center of the box
+        const std::array<size_t, 3> lx = {x0, x0 + nx / 2, x0 + nx - 1};
+        const std::array<size_t, 3> ly = {y0, y0 + ny / 2, y0 + ny - 1};
+        const std::array<size_t, 3> lz = {z0, z0 + nz / 2, z0 + nz - 1};
+        size_t count = 0;
+        for (size_t i = 0; i < 3; i++)
+        {
+            for (size_t j = 0; j < 3; j++)
+            {
+                for (size_t k = 0; k < 3; k++)
+                {
+                    keys[count++] = key(lx[i], ly[j], lz[k]);
+                }
+            }
+        }
+        sample(eval, keys.data(), count);
+
+        // Flood fill the box if all samples agree
+        const game::block_id first = _cells[keys[0]];
+        bool uniform = true;
+        for (size_t k = 1; k < count; k++)
+        {
+            uniform = uniform && (_cells[keys[k]] == first);
+        }
+        if (uniform)
+        {
+            fill(x0, y0, z0, nx, ny, nz, first);
+            return;
+        }
+
+        // Otherwise subdivide into eight children
+        const size_t hx = (nx + 1) / 2;
+        const size_t hy = (ny + 1) / 2;
+        const size_t hz = (nz + 1) / 2;
+        for (size_t i = 0; i < 2; i++)
+        {
+            for (size_t j = 0; j < 2; j++)
+            {
+                for (size_t k = 0; k < 2; k++)
+                {
+                    // Child extents, odd sizes give the first child the extra cell
+                    const size_t cx = (i == 0) ? hx : nx - hx;
+                    const size_t cy = (j == 0) ? hy : ny - hy;
+                    const size_t cz = (k == 0) ? hz : nz - hz;
+                    if (cx > 0 && cy > 0 && cz > 0)
+                    {
+                        node(eval, x0 + i * hx, y0 + j * hy, z0 + k * hz, cx, cy, cz);
+                    }
+                }
+            }
+        }
+    }
+
+  public:
+    adaptive_sampler(std::vector<game::block_id> &grid, const size_t scale)
+        : _scale(scale), _cells(grid) {}
+
+    template <typename E>
+    void generate(game::thread_pool &pool, const E &eval, const size_t chunk_size, const bool verify)
+    {
+        // Create working function for a chunk, chunks own their cells
+        const size_t chunks = (_scale + chunk_size - 1) / chunk_size;
+        const auto work = [this, &eval, chunk_size, chunks](std::mt19937 &gen, const size_t i) {
+            // Chunk origin in the grid
+            const size_t x = (i / (chunks * chunks)) * chunk_size;
+            const size_t y = ((i / chunks) % chunks) * chunk_size;
+            const size_t z = (i % chunks) * chunk_size;
+
+            // Blocks are laid out per chunk so the grid matches generating chunk by chunk
+            box(eval, x, y, z, std::min(chunk_size, _scale - x), std::min(chunk_size, _scale - y), std::min(chunk_size, _scale - z));
+        };
+
+        // Run the job in parallel
+        pool.run(std::cref(work), 0, chunks * chunks * chunks);
+
+        // Check the result against exhaustive evaluation
+        if (verify)
+        {
+            // Create working function
+            std::atomic<size_t> missed(0);
+            const auto check = [this, &eval, &missed](std::mt19937 &gen, const size_t i) {
+                game::block_id exact;
+                eval(&i, 1, &exact);
+                if (exact != _cells[i])
+                {
+                    _cells[i] = exact;
+                    missed++;
+                }
+            };
+
+            // Run the job in parallel
+            pool.run(std::cref(check), 0, _cells.size());
+
+            // Report cells the adaptive pass got wrong, the grid gets the exact result
+            std::cout << "adaptive_sampler: " << missed << " of " << _cells.size() << " cells differ from exhaustive evaluation" << std::endl;
+        }
+    }
+    template <typename E>
+    void generate_chunk(const E &eval, const size_t x, const size_t y, const size_t z, const size_t size)
+    {
+        // Only subdivide blocks of this chunk near the surface
+        box(eval, x, y, z, size, size, size);
+    }
+};
+}
+
+#endif
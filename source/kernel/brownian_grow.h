@@ -18,22 +18,43 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __BROWNIAN_GROW__
 #define __BROWNIAN_GROW__
 
+#include <algorithm>
 #include <game/id.h>
 #include <game/thread_pool.h>
 #include <min/vec3.h>
+#include <random>
+#include <stdexcept>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace kernel
 {
 
+class brownian_walker
+{
+  public:
+    std::tuple<size_t, size_t, size_t> p;
+    size_t point;
+    std::minstd_rand gen;
+
+    brownian_walker(const size_t pt, const uint32_t seed) : point(pt), gen(seed) {}
+};
+
 class brownian_grow
 {
   private:
+    static constexpr size_t _region_width = 16;
+    static constexpr size_t _epoch = 64;
+    static constexpr size_t _walkers = 8;
     const size_t _scale;
     const size_t _seed;
     const size_t _radius;
+    const size_t _regions;
     std::vector<std::tuple<size_t, size_t, size_t>> _points;
+    std::vector<brownian_walker> _walker;
+    std::vector<std::vector<size_t>> _region;
+    std::vector<std::vector<std::pair<size_t, game::block_id>>> _hits;
 
     inline static size_t add(const size_t x, const int dx)
     {
@@ -60,6 +81,10 @@ class brownian_grow
         return false;
     }
     inline static game::block_id color_table(const game::block_id value)
+    {
+        return static_cast<game::block_id>(color_index(static_cast<int_fast8_t>(value)));
+    }
+    inline static int_fast8_t color_index(const int_fast8_t value)
     {
         // This needs to be updated!
         switch (value)
@@ -102,7 +127,8 @@ class brownian_grow
             return 8;
         }
     }
-    inline bool random_walk(const std::vector<game::block_id> &read, std::tuple<size_t, size_t, size_t> &walker, const uint_fast8_t dir, game::block_id &value) const
+    inline bool random_walk(const std::vector<game::block_id> &read, const std::vector<game::block_id> &write,
+                            std::tuple<size_t, size_t, size_t> &walker, const uint_fast8_t dir, game::block_id &value) const
     {
         // Copy walker position
         std::tuple<size_t, size_t, size_t> next = walker;
@@ -148,8 +174,13 @@ class brownian_grow
             }
         }
 
-        // Is the move point a wall?
-        value = read[key(next)];
+        // Is the move point a wall? Growth from earlier epochs counts as a wall
+        const size_t cell = key(next);
+        value = read[cell];
+        if (value == game::block_id::EMPTY)
+        {
+            value = write[cell];
+        }
         if (value == game::block_id::EMPTY)
         {
             // Move the walker
@@ -162,63 +193,99 @@ class brownian_grow
         // We hit a wall
         return true;
     }
-    inline void do_brownian(game::thread_pool &pool, const std::vector<game::block_id> &read, std::vector<game::block_id> &write, const size_t years) const
+    inline void spawn(brownian_walker &w) const
+    {
+        // Spawn walker at random offset from its seed location
+        const int radius = static_cast<int>(_radius);
+        std::uniform_int_distribution<int> gdist(-radius, radius);
+        const std::tuple<size_t, size_t, size_t> &p = _points[w.point];
+        const size_t x = add(std::get<0>(p), gdist(w.gen));
+        const size_t y = add(std::get<1>(p), gdist(w.gen));
+        const size_t z = add(std::get<2>(p), gdist(w.gen));
+        w.p = std::make_tuple(x, y, z);
+    }
+    inline static size_t region(const size_t x)
+    {
+        // Regions are slabs along the x axis
+        return x / _region_width;
+    }
+    inline void do_brownian(game::thread_pool &pool, const std::vector<game::block_id> &read, std::vector<game::block_id> &write, const size_t years)
     {
-        // Create working function
-        const auto work = [this, &read, &write, years](std::mt19937 &gen, const size_t i) {
-            // Create random number generator for this thread
-            std::uniform_int_distribution<int> gdist(-_radius, _radius);
-            std::uniform_int_distribution<uint_fast8_t> idist(0, 5);
-
-            // Spawn a walker at each seed location
-            for (size_t j = 0; j < _seed; j++)
+        // Start every walker at its seed location
+        for (brownian_walker &w : _walker)
+        {
+            spawn(w);
+        }
+
+        // Walk in synchronized epochs, the write buffer only changes between epochs
+        const size_t epoch = _epoch;
+        for (size_t year = 0; year < years; year += epoch)
+        {
+            const size_t steps = std::min(epoch, years - year);
+
+            // Bin walkers by region in walker order
+            for (std::vector<size_t> &r : _region)
+            {
+                r.clear();
+            }
+            const size_t walkers = _walker.size();
+            for (size_t i = 0; i < walkers; i++)
             {
-                // Spawn walker at random offset from seed location
-                const size_t x = add(std::get<0>(_points[j]), gdist(gen));
-                const size_t y = add(std::get<1>(_points[j]), gdist(gen));
-                const size_t z = add(std::get<2>(_points[j]), gdist(gen));
-                auto walker = std::make_tuple(x, y, z);
-
-                // Evolve simulation for years
-                for (size_t k = 0; k < years; k++)
+                _region[region(std::get<0>(_walker[i].p))].push_back(i);
+            }
+
+            // Create working function for walking the walkers of a region
+            const auto walk = [this, &read, &write, steps](std::mt19937 &, const size_t r) {
+                // Clear this region's outgoing hits
+                for (size_t t = 0; t < _regions; t++)
                 {
-                    // Calculate random direction
-                    const uint_fast8_t dir = idist(gen);
+                    _hits[r * _regions + t].clear();
+                }
 
-                    // If walker hits something in write buffer
-                    game::block_id value;
-                    if (random_walk(read, walker, dir, value))
+                std::uniform_int_distribution<uint_fast8_t> idist(0, 5);
+                for (const size_t i : _region[r])
+                {
+                    brownian_walker &w = _walker[i];
+                    for (size_t k = 0; k < steps; k++)
                     {
-                        // Calculate grid cell
-                        const size_t cell = key(walker);
+                        // If walker hits something, queue the hit for the region that owns the cell
+                        game::block_id value;
+                        if (random_walk(read, write, w.p, idist(w.gen), value))
+                        {
+                            const size_t target = region(std::get<0>(w.p));
+                            _hits[r * _regions + target].emplace_back(key(w.p), color_table(value));
+
+                            // Respawn walker
+                            spawn(w);
+                        }
+                    }
+                }
+            };
 
-                        // Seed the write buffer
-                        write[cell] = color_table(value);
+            // Run the walkers of each region in parallel
+            pool.run(std::cref(walk), 0, _regions);
 
-                        // Respawn walker
-                        const size_t x1 = add(std::get<0>(_points[j]), gdist(gen));
-                        const size_t y1 = add(std::get<1>(_points[j]), gdist(gen));
-                        const size_t z1 = add(std::get<2>(_points[j]), gdist(gen));
-                        walker = std::make_tuple(x1, y1, z1);
+            // Create working function for exchanging hits across region boundaries
+            const auto exchange = [this, &write](std::mt19937 &, const size_t t) {
+                // Apply hits in region and walker order so the result doesn't depend on thread count
+                for (size_t r = 0; r < _regions; r++)
+                {
+                    for (const std::pair<size_t, game::block_id> &hit : _hits[r * _regions + t])
+                    {
+                        write[hit.first] = hit.second;
                     }
                 }
-            }
-        };
+            };
 
-        // Get number of cpu cores
-        const size_t size = std::thread::hardware_concurrency();
-        if (size < 1)
-        {
-            throw std::runtime_error("brownian_grow: can't determine number of CPU cores");
+            // Each region seeds its own cells in parallel
+            pool.run(std::cref(exchange), 0, _regions);
         }
-
-        // Run the job in parallel
-        pool.run(std::cref(work), 0, size);
     }
 
   public:
     brownian_grow(std::mt19937 &gen, std::vector<game::block_id> &write, const size_t scale, const size_t radius, const size_t seed)
-        : _scale(scale), _seed(seed), _radius(radius)
+        : _scale(scale), _seed(seed), _radius(radius), _regions((scale + _region_width - 1) / _region_width),
+          _region(_regions), _hits(_regions * _regions)
     {
         // Check if radius is valid
         if (_radius >= _scale / 2)
@@ -240,7 +307,16 @@ class brownian_grow
             const size_t cell = key(_points[i]);
 
             // Write pixel into grid
-            write[cell] = color_table(i % 24);
+            write[cell] = color_table(static_cast<game::block_id>(i % 24));
+        }
+
+        // Each walker owns a generator so walks don't depend on thread scheduling
+        const uint32_t base = gen();
+        const size_t walkers = _seed * _walkers;
+        _walker.reserve(walkers);
+        for (size_t i = 0; i < walkers; i++)
+        {
+            _walker.emplace_back(i / _walkers, base + static_cast<uint32_t>(i));
         }
     }
 
@@ -20,6 +20,8 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <game/id.h>
 #include <game/thread_pool.h>
+#include <kernel/adaptive_sampler.h>
+#include <kernel/mandelbulb_simd.h>
 #include <min/vec3.h>
 
 namespace kernel
@@ -109,6 +111,45 @@ class mandelbulb
     mandelbulb() {}
     template <typename F>
     inline void generate(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
+    {
+        // Use the scalar kernel if there is no SIMD support
+        const simd_isa isa = mandelbulb_simd::isa();
+        if (isa == simd_isa::SCALAR)
+        {
+            generate_scalar(pool, grid, gsize, f);
+            return;
+        }
+
+        // Evaluate rows of cells with SIMD
+        const mandelbulb_simd simd({36, 36, 36}, {126, 126, 126}, {84, 84, 84}, {9, 9, 9}, gsize / 2, false);
+        simd.generate(pool, isa, grid, f);
+    }
+    template <typename F>
+    inline void generate_adaptive(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const size_t chunk_size, const F &f, const bool verify)
+    {
+        // Evaluate sampled cells with SIMD if supported
+        const simd_isa isa = mandelbulb_simd::isa();
+        const mandelbulb_simd simd({36, 36, 36}, {126, 126, 126}, {84, 84, 84}, {9, 9, 9}, gsize / 2, false);
+        const auto eval = [this, isa, &simd, gsize, &f](const size_t *const keys, const size_t count, game::block_id *const out) {
+            if (isa == simd_isa::SCALAR)
+            {
+                for (size_t k = 0; k < count; k++)
+                {
+                    out[k] = do_mandelbulb(f(keys[k]), gsize);
+                }
+            }
+            else
+            {
+                simd.evaluate(isa, f, keys, count, out);
+            }
+        };
+
+        // Only subdivide blocks near the fractal surface
+        adaptive_sampler sampler(grid, gsize);
+        sampler.generate(pool, eval, chunk_size, verify);
+    }
+    template <typename F>
+    inline void generate_scalar(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
     {
         // Create working function
         const auto work = [this, &grid, gsize, &f](std::mt19937 &gen, const size_t i) {
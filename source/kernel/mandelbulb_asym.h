@@ -20,6 +20,8 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <game/id.h>
 #include <game/thread_pool.h>
+#include <kernel/adaptive_sampler.h>
+#include <kernel/mandelbulb_simd.h>
 #include <min/vec3.h>
 
 namespace kernel
@@ -56,7 +58,7 @@ class mandelbulb_asym
     {
         return x * x * x;
     }
-    inline game::block_id do_mandelbulb(const min::vec3<float> &p, const size_t size)
+    inline game::block_id do_mandelbulb(const min::vec3<float> &p, const size_t size) const
     {
         // Copy point
         float x0, x1;
@@ -116,6 +118,27 @@ class mandelbulb_asym
 
         return game::block_id::EMPTY;
     }
+    template <typename F>
+    inline auto evaluator(const size_t gsize, const F &f) const
+    {
+        // Evaluate sampled cells with SIMD if supported
+        const simd_isa isa = mandelbulb_simd::isa();
+        const size_t d = static_cast<size_t>(gsize * 0.6667);
+        const mandelbulb_simd simd({_a, _e, _i}, {_b, _f, _j}, {_c, _g, _k}, {_d, _h, _l}, d, false);
+        return [this, isa, simd, gsize, &f](const size_t *const keys, const size_t count, game::block_id *const out) {
+            if (isa == simd_isa::SCALAR)
+            {
+                for (size_t k = 0; k < count; k++)
+                {
+                    out[k] = do_mandelbulb(f(keys[k]), gsize);
+                }
+            }
+            else
+            {
+                simd.evaluate(isa, f, keys, count, out);
+            }
+        };
+    }
 
   public:
     mandelbulb_asym(const int a, const int b, const int c, const int d,
@@ -166,6 +189,37 @@ class mandelbulb_asym
     }
     template <typename F>
     inline void generate(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
+    {
+        // Use the scalar kernel if there is no SIMD support
+        const simd_isa isa = mandelbulb_simd::isa();
+        if (isa == simd_isa::SCALAR)
+        {
+            generate_scalar(pool, grid, gsize, f);
+            return;
+        }
+
+        // Evaluate rows of cells with SIMD
+        const size_t d = static_cast<size_t>(gsize * 0.6667);
+        const mandelbulb_simd simd({_a, _e, _i}, {_b, _f, _j}, {_c, _g, _k}, {_d, _h, _l}, d, false);
+        simd.generate(pool, isa, grid, f);
+    }
+    template <typename F>
+    inline void generate_adaptive(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const size_t chunk_size, const F &f, const bool verify) const
+    {
+        // Only subdivide blocks near the fractal surface
+        adaptive_sampler sampler(grid, gsize);
+        sampler.generate(pool, evaluator(gsize, f), chunk_size, verify);
+    }
+    template <typename F>
+    inline void generate_chunk(std::vector<game::block_id> &grid, const size_t gsize, const F &f,
+                               const size_t x, const size_t y, const size_t z, const size_t size) const
+    {
+        // Only subdivide blocks of this chunk near the fractal surface
+        adaptive_sampler sampler(grid, gsize);
+        sampler.generate_chunk(evaluator(gsize, f), x, y, z, size);
+    }
+    template <typename F>
+    inline void generate_scalar(game::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
     {
         // Create working function
         const auto work = [this, &grid, gsize, &f](std::mt19937 &gen, const size_t i) {
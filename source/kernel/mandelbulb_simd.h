@@ -0,0 +1,278 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __MANDELBULB_SIMD__
+#define __MANDELBULB_SIMD__
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <min/vec3.h>
+
+namespace kernel
+{
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// Vector types for each lane width
+typedef float simd_v4f __attribute__((vector_size(16)));
+typedef int simd_v4i __attribute__((vector_size(16)));
+typedef float simd_v8f __attribute__((vector_size(32)));
+typedef int simd_v8i __attribute__((vector_size(32)));
+#endif
+
+enum class simd_isa
+{
+    SCALAR,
+    SSE41,
+    AVX2
+};
+
+class mandelbulb_simd
+{
+  public:
+    static constexpr size_t width = 8;
+
+  private:
+    std::array<float, 3> _a;
+    std::array<float, 3> _b;
+    std::array<float, 3> _c;
+    std::array<float, 3> _d;
+    float _scale;
+    bool _exp;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // Evaluate W lanes at once, compiled for the ISA of the calling function
+    template <typename vf, typename vi, size_t W>
+    __attribute__((always_inline)) inline void lanes(const float *const px, const float *const py, const float *const pz, game::block_id *const out) const
+    {
+        // Set start point
+        vf x0, y0, z0;
+        for (size_t k = 0; k < W; k++)
+        {
+            x0[k] = px[k] / _scale;
+            y0[k] = py[k] / _scale;
+            z0[k] = pz[k] / _scale;
+        }
+
+        // Per lane convergence mask and iteration count
+        vi done = {};
+        vi iterations = {};
+        for (int i = 0; i < 32; i++)
+        {
+            // Squares shared by all axes
+            const vf x2 = x0 * x0;
+            const vf y2 = y0 * y0;
+            const vf z2 = z0 * z0;
+            vf dx = y2 + z2;
+            vf dy = z2 + x2;
+            vf dz = x2 + y2;
+            if (_exp)
+            {
+                // No vector exp, evaluated per lane in single precision
+                for (size_t k = 0; k < W; k++)
+                {
+                    dx[k] = std::exp(-dx[k]);
+                    dy[k] = std::exp(-dy[k]);
+                    dz[k] = std::exp(-dz[k]);
+                }
+            }
+
+            // Polynomial for each axis
+            vf x1, y1, z1;
+            axis(x1, x0, x2, dx, 0);
+            axis(y1, y0, y2, dy, 1);
+            axis(z1, z0, z2, dz, 2);
+
+            // Record the first iteration each lane converges
+            const vf ex = x1 - x0;
+            const vf ey = y1 - y0;
+            const vf ez = z1 - z0;
+            const vi conv = (ex < 1E-3f) & (ex > -1E-3f) & (ey < 1E-3f) & (ey > -1E-3f) & (ez < 1E-3f) & (ez > -1E-3f);
+            const vi first = conv & ~done;
+            iterations = (first & i) | (~first & iterations);
+            done |= conv;
+
+            // Stop when all lanes converged
+            bool all = true;
+            for (size_t k = 0; k < W; k++)
+            {
+                all = all && done[k];
+            }
+            if (all)
+            {
+                break;
+            }
+
+            // Prime next loop
+            x0 = x1;
+            y0 = y1;
+            z0 = z1;
+        }
+
+        // Converged lanes become atlas ids
+        for (size_t k = 0; k < W; k++)
+        {
+            out[k] = done[k] ? static_cast<game::block_id>(iterations[k] % 21) : game::block_id::EMPTY;
+        }
+    }
+    template <typename V>
+    __attribute__((always_inline)) inline void axis(V &out, const V &v, const V &v2, const V &dv, const size_t i) const
+    {
+        // v^9 - a v^7 dv + b v^5 dv^2 - c v^3 dv^3 + d v dv^4 + v
+        // Powers multiply in the same order as the scalar kernel so results match
+        const V v3 = v2 * v;
+        const V v4 = v3 * v;
+        const V v5 = v4 * v;
+        const V v6 = v5 * v;
+        const V v7 = v6 * v;
+        const V v8 = v7 * v;
+        const V v9 = v8 * v;
+        const V dv2 = dv * dv;
+        const V dv3 = dv2 * dv;
+        const V dv4 = dv3 * dv;
+
+        out = v9 - _a[i] * v7 * dv + _b[i] * v5 * dv2 - _c[i] * v3 * dv3 + _d[i] * v * dv4 + v;
+    }
+    __attribute__((target("avx2"))) void run_avx2(const float *const x, const float *const y, const float *const z, game::block_id *const out) const
+    {
+        lanes<simd_v8f, simd_v8i, 8>(x, y, z, out);
+    }
+    __attribute__((target("sse4.1"))) void run_sse41(const float *const x, const float *const y, const float *const z, game::block_id *const out) const
+    {
+        lanes<simd_v4f, simd_v4i, 4>(x, y, z, out);
+        lanes<simd_v4f, simd_v4i, 4>(x + 4, y + 4, z + 4, out + 4);
+    }
+#endif
+
+  public:
+    mandelbulb_simd(const std::array<int, 3> &a, const std::array<int, 3> &b, const std::array<int, 3> &c, const std::array<int, 3> &d,
+                    const size_t scale, const bool exp)
+        : _scale(static_cast<float>(scale)), _exp(exp)
+    {
+        // Coefficients for the x, y and z polynomials
+        for (size_t i = 0; i < 3; i++)
+        {
+            _a[i] = static_cast<float>(a[i]);
+            _b[i] = static_cast<float>(b[i]);
+            _c[i] = static_cast<float>(c[i]);
+            _d[i] = static_cast<float>(d[i]);
+        }
+    }
+
+    template <typename F>
+    inline void evaluate(const simd_isa isa, const F &f, const size_t *const keys, const size_t count, game::block_id *const out) const
+    {
+        // Evaluate arbitrary cells in rows of eight
+        for (size_t start = 0; start < count; start += width)
+        {
+            // Gather cell centers, pad the last row
+            const size_t n = (start + width > count) ? count - start : width;
+            std::array<float, width> x = {};
+            std::array<float, width> y = {};
+            std::array<float, width> z = {};
+            for (size_t k = 0; k < n; k++)
+            {
+                const min::vec3<float> p = f(keys[start + k]);
+                x[k] = p.x();
+                y[k] = p.y();
+                z[k] = p.z();
+            }
+
+            // Evaluate the row together
+            std::array<game::block_id, width> row;
+            run(isa, x.data(), y.data(), z.data(), row.data());
+            std::copy(row.begin(), row.begin() + n, out + start);
+        }
+    }
+    template <typename F>
+    inline void generate(game::thread_pool &pool, const simd_isa isa, std::vector<game::block_id> &grid, const F &f) const
+    {
+        // Create working function for a row of cells
+        const size_t size = grid.size();
+        const auto work = [this, isa, &grid, size, &f](std::mt19937 &, const size_t row) {
+            // Gather cell centers, pad the last row
+            const size_t start = row * width;
+            const size_t count = (start + width > size) ? size - start : width;
+            std::array<float, width> x = {};
+            std::array<float, width> y = {};
+            std::array<float, width> z = {};
+            for (size_t k = 0; k < count; k++)
+            {
+                const min::vec3<float> p = f(start + k);
+                x[k] = p.x();
+                y[k] = p.y();
+                z[k] = p.z();
+            }
+
+            // Evaluate the row together
+            std::array<game::block_id, width> out;
+            run(isa, x.data(), y.data(), z.data(), out.data());
+
+            // Only write empty cells
+            for (size_t k = 0; k < count; k++)
+            {
+                if (grid[start + k] == game::block_id::EMPTY)
+                {
+                    grid[start + k] = out[k];
+                }
+            }
+        };
+
+        // Run the job in parallel
+        pool.run(std::cref(work), 0, (size + width - 1) / width);
+    }
+    static inline simd_isa isa()
+    {
+        // Detect the best instruction set once
+        static const simd_isa best = []() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return simd_isa::AVX2;
+            }
+            else if (__builtin_cpu_supports("sse4.1"))
+            {
+                return simd_isa::SSE41;
+            }
+#endif
+            return simd_isa::SCALAR;
+        }();
+
+        return best;
+    }
+    inline void run(const simd_isa isa, const float *const x, const float *const y, const float *const z, game::block_id *const out) const
+    {
+        // Evaluate a row of eight cells, scalar falls back to the caller
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        if (isa == simd_isa::AVX2)
+        {
+            run_avx2(x, y, z, out);
+        }
+        else if (isa == simd_isa::SSE41)
+        {
+            run_sse41(x, y, z, out);
+        }
+#endif
+    }
+};
+}
+
+#endif
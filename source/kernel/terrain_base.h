@@ -18,10 +18,15 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __TERRAIN_BASE__
 #define __TERRAIN_BASE__
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <game/chunk_pipeline.h>
 #include <game/id.h>
 #include <game/perlin.h>
-#include <game/thread_pool.h>
 #include <min/vec3.h>
+#include <random>
+#include <vector>
 
 namespace kernel
 {
@@ -29,12 +34,64 @@ namespace kernel
 class terrain_base
 {
   private:
+    static constexpr size_t _bands = 8;
     const size_t _scale;
     const size_t _chunk_size;
     const size_t _start;
     const size_t _stop;
+    const uint32_t _seed;
     perlin_noise _noise;
-
+    std::vector<float> _rz;
+    std::array<float, _bands> _low;
+    std::array<float, _bands> _high;
+    std::array<uint_fast8_t, _bands> _limit;
+    std::array<game::block_id, _bands> _rare;
+    std::array<game::block_id, _bands> _common;
+
+    static inline float threshold(const double t)
+    {
+        // Smallest float not below t, so float compares match compares against t
+        const float f = static_cast<float>(t);
+        return (f < t) ? std::nextafter(f, 2.0f) : f;
+    }
+    inline void band(const size_t b, const double low, const double high, const uint_fast8_t limit,
+                     const game::block_id rare, const game::block_id common)
+    {
+        // Noise in [low, high) is doped with a rare block
+        _low[b] = threshold(low);
+        _high[b] = threshold(high);
+        _limit[b] = limit;
+        _rare[b] = rare;
+        _common[b] = common;
+    }
+    inline void calc_bands()
+    {
+        band(0, 0.0, 0.10, 2, game::block_id::GOLD, game::block_id::STONE1);
+        band(1, 0.10, 0.15, 4, game::block_id::SILVER, game::block_id::STONE2);
+        band(2, 0.15, 0.20, 6, game::block_id::IRON, game::block_id::IRIDIUM);
+        band(3, 0.20, 0.25, 6, game::block_id::COPPER, game::block_id::DIRT1);
+        band(4, 0.35, 0.40, 8, game::block_id::CALCIUM, game::block_id::DIRT2);
+        band(5, 0.40, 0.45, 10, game::block_id::SODIUM, game::block_id::CLAY1);
+        band(6, 0.45, 0.50, 8, game::block_id::MAGNESIUM, game::block_id::CLAY2);
+        band(7, 0.51, 0.515, 10, game::block_id::POTASSIUM, game::block_id::SODIUM);
+    }
+    inline void classify(const float *const value, uint8_t *const out, const size_t size) const
+    {
+        // Zero means no band, bands don't overlap
+        std::fill(out, out + size, 0);
+        for (size_t b = 0; b < _bands; b++)
+        {
+            // Branch free compare of the whole row, vectorized by the compiler
+            const float low = _low[b];
+            const float high = _high[b];
+            const uint8_t id = static_cast<uint8_t>(b + 1);
+            for (size_t k = 0; k < size; k++)
+            {
+                const bool in = (value[k] >= low) & (value[k] < high);
+                out[k] = in ? id : out[k];
+            }
+        }
+    }
     inline size_t key(const std::tuple<size_t, size_t, size_t> &index) const
     {
         return min::vec3<float>::grid_key(index, _scale);
@@ -48,141 +105,85 @@ class terrain_base
 
         return false;
     }
-    inline float do_perlin(const size_t x, const size_t y, const size_t z) const
+
+  public:
+    terrain_base(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop, const uint32_t seed)
+        : _scale(scale), _chunk_size(chunk_size), _start(start), _stop(stop), _seed(seed), _noise(seed), _rz(scale)
     {
-        // Relative grid components in chunk
-        const float inv_cs = 1.0 / _chunk_size;
-        const float rx = x * inv_cs;
-        const float ry = y * inv_cs;
-        const float rz = z * inv_cs;
+        // Load the mineral bands
+        calc_bands();
 
-        // Calculate noise for this grid cell
-        return _noise.perlin(rx, ry, rz);
+        // Relative grid components in chunk, z positions are shared by every row
+        const float inv_cs = 1.0 / _chunk_size;
+        for (size_t k = 0; k < _scale; k++)
+        {
+            _rz[k] = k * inv_cs;
+        }
     }
 
-  public:
-    terrain_base(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop)
-        : _scale(scale), _chunk_size(chunk_size), _start(start), _stop(stop) {}
-
-    inline void generate(game::thread_pool &pool, std::vector<game::block_id> &write) const
+    inline void generate_chunk(std::vector<game::block_id> &write, const size_t x, const size_t y, const size_t z) const
     {
-        // Create working function
-        const auto work = [this, &write](std::mt19937 &gen, const size_t i) {
-            // Dope minerals in base
-            std::uniform_int_distribution<uint_fast8_t> dope(0, 110);
+        // Rows of this chunk in the base layers
+        const size_t y_start = std::max(y, _start);
+        const size_t y_end = std::min(y + _chunk_size, _stop);
+        if (y_start >= y_end)
+        {
+            return;
+        }
+
+        // Seed each chunk so results don't depend on thread scheduling
+        std::minstd_rand gen(game::chunk_pipeline::mix(_seed, key(std::make_tuple(x, y, z))));
+
+        // Dope minerals in base
+        std::uniform_int_distribution<uint_fast8_t> dope(0, 110);
 
-            // Fill out this section
-            for (size_t j = _start; j < _stop; j++)
+        // Scratch rows for this chunk
+        std::vector<float> value(_chunk_size);
+        std::vector<uint8_t> bands(_chunk_size);
+
+        // Cells of each row inside the world edge
+        const float inv_cs = 1.0 / _chunk_size;
+        const size_t k_start = std::max(z, static_cast<size_t>(1));
+        const size_t k_end = std::min(z + _chunk_size, _scale - 1);
+        const size_t inner = k_end - k_start;
+
+        // Fill out this chunk a z row at a time
+        for (size_t i = x; i < x + _chunk_size; i++)
+        {
+            for (size_t j = y_start; j < y_end; j++)
             {
-                for (size_t k = 0; k < _scale; k++)
+                // If on edge, write as STONE2
+                const size_t row = key(std::make_tuple(i, j, z));
+                if (on_edge(i) || on_edge(j))
+                {
+                    std::fill(write.begin() + row, write.begin() + row + _chunk_size, game::block_id::STONE2);
+                    continue;
+                }
+                if (k_start > z)
+                {
+                    write[row] = game::block_id::STONE2;
+                }
+                if (k_end < z + _chunk_size)
                 {
-                    // Calculate key index
-                    const size_t index = key(std::make_tuple(i, j, k));
+                    write[row + _chunk_size - 1] = game::block_id::STONE2;
+                }
 
-                    // If on edge, write as STONE2
-                    if (on_edge(i) || on_edge(j) || on_edge(k))
-                    {
-                        write[index] = game::block_id::STONE2;
-                    }
-                    else
+                // Calculate 3d perlin and classify the inside of the row
+                _noise.perlin(i * inv_cs, j * inv_cs, &_rz[k_start], value.data(), inner);
+                classify(value.data(), bands.data(), inner);
+
+                // Dope the doped cells
+                const size_t start = row + (k_start - z);
+                for (size_t k = 0; k < inner; k++)
+                {
+                    const uint8_t b = bands[k];
+                    if (b > 0)
                     {
-                        // Calculate 3d perlin
-                        const float value = do_perlin(i, j, k);
-                        if (value >= 0.0 && value < 0.10)
-                        {
-                            if (dope(gen) <= 2)
-                            {
-                                write[index] = game::block_id::GOLD;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::STONE1;
-                            }
-                        }
-                        else if (value >= 0.10 && value < 0.15)
-                        {
-                            if (dope(gen) <= 4)
-                            {
-                                write[index] = game::block_id::SILVER;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::STONE2;
-                            }
-                        }
-                        else if (value >= 0.15 && value < 0.20)
-                        {
-                            if (dope(gen) <= 6)
-                            {
-                                write[index] = game::block_id::IRON;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::IRIDIUM;
-                            }
-                        }
-                        else if (value >= 0.20 && value < 0.25)
-                        {
-                            if (dope(gen) <= 6)
-                            {
-                                write[index] = game::block_id::COPPER;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::DIRT1;
-                            }
-                        }
-                        else if (value >= 0.35 && value < 0.40)
-                        {
-                            if (dope(gen) <= 8)
-                            {
-                                write[index] = game::block_id::CALCIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::DIRT2;
-                            }
-                        }
-                        else if (value >= 0.40 && value < 0.45)
-                        {
-                            if (dope(gen) <= 10)
-                            {
-                                write[index] = game::block_id::SODIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::CLAY1;
-                            }
-                        }
-                        else if (value >= 0.45 && value < 0.50)
-                        {
-                            if (dope(gen) <= 8)
-                            {
-                                write[index] = game::block_id::MAGNESIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::CLAY2;
-                            }
-                        }
-                        else if (value >= 0.51 && value < 0.515)
-                        {
-                            if (dope(gen) <= 10)
-                            {
-                                write[index] = game::block_id::POTASSIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::SODIUM;
-                            }
-                        }
+                        write[start + k] = (dope(gen) <= _limit[b - 1]) ? _rare[b - 1] : _common[b - 1];
                     }
                 }
             }
-        };
-
-        // Parallelize on X axis
-        pool.run(std::cref(work), 0, _scale);
+        }
     }
 };
 }
@@ -18,10 +18,17 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef __TERRAIN_HEIGHT__
 #define __TERRAIN_HEIGHT__
 
+#include <algorithm>
+#include <cmath>
+#include <game/chunk_pipeline.h>
 #include <game/height_map.h>
 #include <game/id.h>
 #include <game/thread_pool.h>
 #include <min/vec3.h>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace kernel
 {
@@ -30,175 +37,320 @@ class terrain_height
 {
   private:
     const size_t _scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
     const size_t _start;
     const size_t _stop;
+    const game::height_map<float, float> _map;
+    uint32_t _terrain_seed;
+    uint32_t _tree_seed;
+    uint32_t _plant_seed;
+    size_t _tree_jitter;
+    size_t _plant_jitter;
+    std::vector<std::tuple<size_t, size_t, size_t, size_t>> _trees;
+    std::vector<std::pair<size_t, size_t>> _plants;
 
     inline size_t key(const std::tuple<size_t, size_t, size_t> &index) const
     {
         return min::vec3<float>::grid_key(index, _scale);
     }
-    inline bool on_edge(const size_t x) const
+    inline size_t chunk_key(const size_t x, const size_t y, const size_t z) const
     {
-        if (x == 0 || x == _scale - 1)
+        return ((x / _chunk_size) * _chunk_scale + (y / _chunk_size)) * _chunk_scale + (z / _chunk_size);
+    }
+    inline size_t column_key(const size_t x, const size_t z) const
+    {
+        return (x / _chunk_size) * _chunk_scale + (z / _chunk_size);
+    }
+    inline bool in_chunk(const size_t x, const size_t y, const size_t z, const size_t cx, const size_t cy, const size_t cz) const
+    {
+        return x - cx < _chunk_size && y - cy < _chunk_size && z - cz < _chunk_size;
+    }
+    static inline size_t map_level(const size_t scale)
+    {
+        return static_cast<size_t>(std::ceil(std::log2(scale)));
+    }
+    inline size_t surface(const size_t x, const size_t z) const
+    {
+        // First cell above the terrain at X/Z coord
+        return _start + static_cast<size_t>(std::round(_map.get(x, z)));
+    }
+    inline size_t cell_size(const size_t count) const
+    {
+        // Square jitter cells so the placement area holds about count of them
+        const size_t width = _scale - 6;
+        const size_t cells = std::max(static_cast<size_t>(std::round(std::sqrt(static_cast<float>(count)))), static_cast<size_t>(1));
+
+        // Round the cell size up so there are never more cells than asked for
+        return (width + cells - 1) / cells;
+    }
+    inline size_t cell_count(const size_t cell_size) const
+    {
+        // Jitter cells along each axis
+        return (_scale - 6 + cell_size - 1) / cell_size;
+    }
+    inline void cell_point(const size_t cell, const size_t cell_size, std::mt19937 &gen, size_t &x, size_t &z) const
+    {
+        // Unpack the jitter cell, placements are between 3 and scale - 4
+        const size_t cells = cell_count(cell_size);
+        const size_t x0 = 3 + (cell / cells) * cell_size;
+        const size_t z0 = 3 + (cell % cells) * cell_size;
+
+        // Random point inside the cell, clipped to the placement area
+        const size_t x1 = std::min(x0 + cell_size, _scale - 3);
+        const size_t z1 = std::min(z0 + cell_size, _scale - 3);
+        std::uniform_int_distribution<size_t> px(x0, x1 - 1);
+        std::uniform_int_distribution<size_t> pz(z0, z1 - 1);
+        x = px(gen);
+        z = pz(gen);
+    }
+    inline void place_plants(const size_t size)
+    {
+        // One plant per jitter cell, sorted by chunk so each chunk finds its plants
+        _plant_jitter = cell_size(size);
+        const size_t cells = cell_count(_plant_jitter);
+        _plants.reserve(cells * cells);
+        for (size_t i = 0; i < cells * cells; i++)
         {
-            return true;
-        }
+            std::mt19937 gen(_plant_seed + static_cast<uint32_t>(i));
 
-        return false;
+            // Get random X/Z coord in this cell, Y from height map
+            size_t x, z;
+            cell_point(i, _plant_jitter, gen, x, z);
+            _plants.emplace_back(chunk_key(x, surface(x, z), z), i);
+        }
+        std::sort(_plants.begin(), _plants.end());
     }
-    inline void terrain(game::thread_pool &pool, std::vector<game::block_id> &write, const game::height_map<float, float> &map) const
+    inline void place_trees(const size_t size)
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t grass_start = game::id_value(game::block_id::GRASS1);
-            const int_fast8_t grass_end = game::id_value(game::block_id::GRASS2);
-            const int_fast8_t dirt_start = game::id_value(game::block_id::DIRT1);
-            const int_fast8_t dirt_end = game::id_value(game::block_id::DIRT2);
-            const int_fast8_t sand_start = game::id_value(game::block_id::SAND1);
-            const int_fast8_t sand_end = game::id_value(game::block_id::SAND2);
-            std::uniform_int_distribution<int_fast8_t> grass(grass_start, grass_end);
-            std::uniform_int_distribution<int_fast8_t> soil(dirt_start, dirt_end);
-            std::uniform_int_distribution<int_fast8_t> sand(sand_start, sand_end);
+        // One tree per jitter cell
+        _tree_jitter = cell_size(size);
+        const size_t cells = cell_count(_tree_jitter);
+        for (size_t i = 0; i < cells * cells; i++)
+        {
+            std::mt19937 gen(_tree_seed + static_cast<uint32_t>(i));
 
-            // Z axis
-            for (size_t k = 0; k < _scale; k++)
-            {
-                // Get the height
-                const size_t level = static_cast<size_t>(std::round(map.get(i, k)));
-                const size_t height = (level > _stop) ? _stop : level;
-                const size_t mid = _start + (height / 2);
-                const size_t end = _start + (height - 1);
+            // Get random X/Z coord in this cell and the height of the tree
+            size_t x, z;
+            cell_point(i, _tree_jitter, gen, x, z);
+            const size_t base = surface(x, z);
+            const size_t top = tree_top(base, gen);
 
-                // Sand section
-                for (size_t j = _start; j < mid; j++)
-                {
-                    const size_t write_key = key(std::make_tuple(i, j, k));
-                    write[write_key] = static_cast<game::block_id>(sand(gen));
-                }
+            // Leaves reach two cells around the trunk and one cell above the top
+            const size_t low = std::min(base, top - 2);
+            const size_t high = top + 1;
 
-                // Soil section
-                for (size_t j = mid; j < end; j++)
+            // Every chunk column the tree touches draws its part of the tree
+            for (size_t cx = (x - 2) / _chunk_size; cx <= (x + 2) / _chunk_size; cx++)
+            {
+                for (size_t cz = (z - 2) / _chunk_size; cz <= (z + 2) / _chunk_size; cz++)
                 {
-                    const size_t write_key = key(std::make_tuple(i, j, k));
-                    write[write_key] = static_cast<game::block_id>(soil(gen));
+                    _trees.emplace_back(cx * _chunk_scale + cz, i, low, high);
                 }
-
-                // Grass surface
-                const size_t write_key = key(std::make_tuple(i, end, k));
-                write[write_key] = static_cast<game::block_id>(grass(gen));
             }
-        };
+        }
 
-        // Run height map in parallel
-        pool.run(std::cref(work), 0, _scale);
+        // Sorted by column, then by cell so overlaps resolve the same way in every chunk
+        std::sort(_trees.begin(), _trees.end());
     }
-    inline void plants(game::thread_pool &pool, std::vector<game::block_id> &write, const game::height_map<float, float> &map, const size_t size) const
+    inline size_t tree_top(const size_t base, std::mt19937 &gen) const
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t plant_start = game::id_value(game::block_id::TOMATO);
-            const int_fast8_t plant_end = game::id_value(game::block_id::GREEN_PEPPER);
-            std::uniform_int_distribution<int_fast8_t> plant(plant_start, plant_end);
+        // Random numbers between 4 and 18, including both
+        std::uniform_int_distribution<uint_fast8_t> tree_size(4, 18);
 
-            // Get random X/Z coord, Y from height map
-            std::uniform_int_distribution<size_t> p(3, _scale - 4);
-            const size_t x = p(gen);
-            const size_t z = p(gen);
-            const size_t y = _start + static_cast<size_t>(std::round(map.get(x, z)));
+        // Get the top of trees at X/Z coord
+        const size_t height = base + tree_size(gen);
+        return (height > _stop) ? _stop : height;
+    }
+    inline void tree(std::vector<game::block_id> &write, const size_t x, const size_t z, std::mt19937 &gen,
+                     const size_t cx, const size_t cy, const size_t cz) const
+    {
+        // Tree block types
+        const int_fast8_t leaf_start = game::id_value(game::block_id::LEAF1);
+        const int_fast8_t leaf_end = game::id_value(game::block_id::LEAF4);
+        const int_fast8_t wood_start = game::id_value(game::block_id::WOOD1);
+        const int_fast8_t wood_end = game::id_value(game::block_id::WOOD2);
+        std::uniform_int_distribution<int_fast8_t> wood(wood_start, wood_end);
+        std::uniform_int_distribution<int_fast8_t> leaf(leaf_start, leaf_end);
 
-            // Create plants in empty cells on top of height map
-            const size_t write_key = key(std::make_tuple(x, y, z));
-            if (write[write_key] == game::block_id::EMPTY)
-            {
-                write[write_key] = static_cast<game::block_id>(plant(gen));
-            }
-        };
-
-        // Run height map in parallel
-        pool.run(std::cref(work), 0, size);
-    }
-    inline void trees(game::thread_pool &pool, std::vector<game::block_id> &write, const game::height_map<float, float> &map, const size_t size) const
-    {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t leaf_start = game::id_value(game::block_id::LEAF1);
-            const int_fast8_t leaf_end = game::id_value(game::block_id::LEAF4);
-            const int_fast8_t wood_start = game::id_value(game::block_id::WOOD1);
-            const int_fast8_t wood_end = game::id_value(game::block_id::WOOD2);
-
-            // Random numbers between 5 and 13, including both
-            std::uniform_int_distribution<uint_fast8_t> tree_size(4, 18);
-            std::uniform_int_distribution<int_fast8_t> wood(wood_start, wood_end);
-            std::uniform_int_distribution<int_fast8_t> leaf(leaf_start, leaf_end);
-
-            // Get random X/Z coord
-            std::uniform_int_distribution<size_t> p(3, _scale - 4);
-            const size_t x = p(gen);
-            const size_t z = p(gen);
-
-            // Get the top of trees at X/Z coord
-            const size_t tree_base = _start + static_cast<size_t>(std::round(map.get(x, z)));
-            const size_t tree_height = tree_base + tree_size(gen);
-            const size_t tree_top = (tree_height > _stop) ? _stop : tree_height;
-
-            // Create tree wood
-            const int_fast8_t wood_type = wood(gen);
-            for (size_t y = tree_base; y < tree_top; y++)
+        // Get the top of trees at X/Z coord
+        const size_t tree_base = surface(x, z);
+        const size_t top = tree_top(tree_base, gen);
+
+        // Create tree wood, only cells in this chunk are written but every random number is drawn
+        const int_fast8_t wood_type = wood(gen);
+        for (size_t y = tree_base; y < top; y++)
+        {
+            if (in_chunk(x, y, z, cx, cy, cz))
             {
                 const size_t write_key = key(std::make_tuple(x, y, z));
                 write[write_key] = static_cast<game::block_id>(wood_type);
             }
+        }
 
-            // Leaf start position and leaf type
-            const size_t x_start = x - 2;
-            const size_t y_start = tree_top - 2;
-            const size_t z_start = z - 2;
-            const int_fast8_t leaf_type = leaf(gen);
-
-            // Generate cubic leaves
-            std::uniform_int_distribution<uint_fast8_t> leaf_offset(0, 1);
-            const size_t dx = leaf_offset(gen);
-            const size_t x_end = x_start + (5 - dx);
-            for (size_t x = x_start + dx; x < x_end; x++)
+        // Leaf start position and leaf type
+        const size_t x_start = x - 2;
+        const size_t y_start = top - 2;
+        const size_t z_start = z - 2;
+        const int_fast8_t leaf_type = leaf(gen);
+
+        // Generate cubic leaves
+        std::uniform_int_distribution<uint_fast8_t> leaf_offset(0, 1);
+        const size_t dx = leaf_offset(gen);
+        const size_t x_end = x_start + (5 - dx);
+        for (size_t x = x_start + dx; x < x_end; x++)
+        {
+            const size_t y_end = y_start + 3;
+            for (size_t y = y_start; y < y_end; y++)
             {
-                const size_t y_end = y_start + 3;
-                for (size_t y = y_start; y < y_end; y++)
+                const size_t dz = leaf_offset(gen);
+                const size_t z_end = z_start + (5 - dz);
+                for (size_t z = z_start + dz; z < z_end; z++)
                 {
-                    const size_t dz = leaf_offset(gen);
-                    const size_t z_end = z_start + (5 - dz);
-                    for (size_t z = z_start + dz; z < z_end; z++)
+                    if (in_chunk(x, y, z, cx, cy, cz))
                     {
                         const size_t write_key = key(std::make_tuple(x, y, z));
                         write[write_key] = static_cast<game::block_id>(leaf_type);
                     }
                 }
             }
-        };
-
-        // Run height map in parallel
-        pool.run(std::cref(work), 0, size);
+        }
     }
 
   public:
-    terrain_height(const size_t scale, const size_t start, const size_t stop)
-        : _scale(scale), _start(start), _stop(stop) {}
-
-    inline void generate(game::thread_pool &pool, std::mt19937 &gen, std::vector<game::block_id> &write) const
+    terrain_height(game::thread_pool &pool, const size_t scale, const size_t chunk_size, const size_t start, const size_t stop, const uint32_t seed)
+        : _scale(scale), _chunk_size(chunk_size), _chunk_scale(scale / chunk_size), _start(start), _stop(stop),
+          _map(pool, map_level(scale), 4.0, 8.0, game::chunk_pipeline::mix(seed, 0))
     {
-        // Generate height map
-        const size_t level = std::ceil(std::log2(_scale));
-        const game::height_map<float, float> map(level, 4.0, 8.0);
-
-        // Generate terrain
-        terrain(pool, write, map);
+        // Derive a seed for each stage from the world seed
+        std::mt19937 gen(seed);
+        _terrain_seed = gen();
 
-        // Generate trees
+        // Place trees
         std::uniform_int_distribution<size_t> tree_dist(250, 1000);
-        trees(pool, write, map, tree_dist(gen));
+        const size_t tree_count = tree_dist(gen);
+        _tree_seed = gen();
+        place_trees(tree_count);
 
-        // Generate plants
+        // Place plants
         std::uniform_int_distribution<size_t> plant_dist(50, 150);
-        plants(pool, write, map, plant_dist(gen));
+        const size_t plant_count = plant_dist(gen);
+        _plant_seed = gen();
+        place_plants(plant_count);
+    }
+
+    inline size_t get_plant_count() const
+    {
+        return _plants.size();
+    }
+    inline size_t get_tree_count() const
+    {
+        const size_t cells = cell_count(_tree_jitter);
+        return cells * cells;
+    }
+    inline void generate_plants(std::vector<game::block_id> &write, const size_t x, const size_t y, const size_t z) const
+    {
+        // Plants in this chunk
+        const size_t chunk = chunk_key(x, y, z);
+        const auto begin = std::lower_bound(_plants.begin(), _plants.end(), std::make_pair(chunk, static_cast<size_t>(0)));
+        for (auto i = begin; i != _plants.end() && i->first == chunk; i++)
+        {
+            const size_t cell = i->second;
+            std::mt19937 gen(_plant_seed + static_cast<uint32_t>(cell));
+
+            // Plant types
+            const int_fast8_t plant_start = game::id_value(game::block_id::TOMATO);
+            const int_fast8_t plant_end = game::id_value(game::block_id::GREEN_PEPPER);
+            std::uniform_int_distribution<int_fast8_t> plant(plant_start, plant_end);
+
+            // Get random X/Z coord in this cell, Y from height map
+            size_t px, pz;
+            cell_point(cell, _plant_jitter, gen, px, pz);
+            const size_t py = surface(px, pz);
+
+            // Create plants in empty cells on top of height map
+            const size_t write_key = key(std::make_tuple(px, py, pz));
+            if (write[write_key] == game::block_id::EMPTY)
+            {
+                write[write_key] = static_cast<game::block_id>(plant(gen));
+            }
+        }
+    }
+    inline void generate_terrain(std::vector<game::block_id> &write, const size_t x, const size_t y, const size_t z) const
+    {
+        // Skip chunks below the terrain
+        const size_t y_end = y + _chunk_size;
+        if (y_end <= _start)
+        {
+            return;
+        }
+
+        // Seed each chunk so results don't depend on thread scheduling
+        std::minstd_rand gen(game::chunk_pipeline::mix(_terrain_seed, key(std::make_tuple(x, y, z))));
+
+        const int_fast8_t grass_start = game::id_value(game::block_id::GRASS1);
+        const int_fast8_t grass_end = game::id_value(game::block_id::GRASS2);
+        const int_fast8_t dirt_start = game::id_value(game::block_id::DIRT1);
+        const int_fast8_t dirt_end = game::id_value(game::block_id::DIRT2);
+        const int_fast8_t sand_start = game::id_value(game::block_id::SAND1);
+        const int_fast8_t sand_end = game::id_value(game::block_id::SAND2);
+        std::uniform_int_distribution<int_fast8_t> grass(grass_start, grass_end);
+        std::uniform_int_distribution<int_fast8_t> soil(dirt_start, dirt_end);
+        std::uniform_int_distribution<int_fast8_t> sand(sand_start, sand_end);
+
+        // Columns of this chunk
+        for (size_t i = x; i < x + _chunk_size; i++)
+        {
+            for (size_t k = z; k < z + _chunk_size; k++)
+            {
+                // Get the height
+                const size_t level = static_cast<size_t>(std::round(_map.get(i, k)));
+                const size_t height = (level > _stop) ? _stop : level;
+                const size_t mid = _start + (height / 2);
+                const size_t end = _start + (height - 1);
+
+                // Sand section, soil section and grass surface in this chunk
+                const size_t j_start = std::max(y, _start);
+                const size_t j_end = std::min(y_end, end + 1);
+                for (size_t j = j_start; j < j_end; j++)
+                {
+                    const size_t write_key = key(std::make_tuple(i, j, k));
+                    if (j < mid)
+                    {
+                        write[write_key] = static_cast<game::block_id>(sand(gen));
+                    }
+                    else if (j < end)
+                    {
+                        write[write_key] = static_cast<game::block_id>(soil(gen));
+                    }
+                    else
+                    {
+                        write[write_key] = static_cast<game::block_id>(grass(gen));
+                    }
+                }
+            }
+        }
+    }
+    inline void generate_trees(std::vector<game::block_id> &write, const size_t x, const size_t y, const size_t z) const
+    {
+        // Trees touching this chunk column
+        const size_t column = column_key(x, z);
+        const auto begin = std::lower_bound(_trees.begin(), _trees.end(), std::make_tuple(column, static_cast<size_t>(0), static_cast<size_t>(0), static_cast<size_t>(0)));
+        for (auto i = begin; i != _trees.end() && std::get<0>(*i) == column; i++)
+        {
+            // Skip trees above or below this chunk
+            if (std::get<3>(*i) <= y || std::get<2>(*i) >= y + _chunk_size)
+            {
+                continue;
+            }
+
+            // Replay the tree from its seed and draw the part in this chunk
+            const size_t cell = std::get<1>(*i);
+            std::mt19937 gen(_tree_seed + static_cast<uint32_t>(cell));
+            size_t tx, tz;
+            cell_point(cell, _tree_jitter, gen, tx, tz);
+            tree(write, tx, tz, gen, x, y, z);
+        }
     }
 };
 }
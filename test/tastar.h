@@ -0,0 +1,90 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_ASTAR__
+#define __TEST_ASTAR__
+
+#include <game/astar.h>
+#include <stdexcept>
+#include <test.h>
+
+bool test_astar()
+{
+    bool out = true;
+
+    // Create an empty grid
+    const size_t scale = 16;
+    const size_t scale2 = scale * scale;
+    std::vector<game::block_id> grid(scale2 * scale, game::block_id::EMPTY);
+
+    // Build a wall at x = 8 with a single hole in the corner
+    for (size_t y = 0; y < scale; y++)
+    {
+        for (size_t z = 0; z < scale; z++)
+        {
+            if (y != scale - 1 || z != scale - 1)
+            {
+                grid[8 * scale2 + y * scale + z] = game::block_id::STONE1;
+            }
+        }
+    }
+
+    // Create the search with enough budget to cover the grid
+    game::astar search(scale, 4096);
+    std::vector<size_t> path;
+    const size_t start = 0;
+    const size_t stop = (scale - 1) * scale2;
+
+    // Search repeatedly to exercise the generation stamps
+    for (size_t i = 0; i < 3; i++)
+    {
+        const bool found = search.search(path, grid, start, stop, 1000);
+
+        // Shortest path goes through the hole, 15 + 2 * 15 + 2 * 15 moves
+        out = out && found;
+        out = out && compare(76, path.size());
+        out = out && compare(start, path.front());
+        out = out && compare(stop, path.back());
+        if (!out)
+        {
+            throw std::runtime_error("Failed astar search");
+        }
+    }
+
+    // Test path limit
+    search.search(path, grid, start, stop, 20);
+    out = out && compare(20, path.size());
+    if (!out)
+    {
+        throw std::runtime_error("Failed astar path limit");
+    }
+
+    // Test node budget returns a partial path
+    game::astar small(scale, 50);
+    const bool found = small.search(path, grid, start, stop, 1000);
+    out = out && !found;
+    out = out && (path.size() > 1);
+    if (!out)
+    {
+        throw std::runtime_error("Failed astar node budget");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
@@ -0,0 +1,77 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_BROWNIAN_GROW__
+#define __TEST_BROWNIAN_GROW__
+
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <kernel/brownian_grow.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<game::block_id> test_brownian_grow_generate(const unsigned threads)
+{
+    // Create a threadpool with this many threads
+    game::thread_pool pool(threads);
+
+    // Grow from the same seed points
+    const size_t scale = 64;
+    std::mt19937 gen(7);
+    const std::vector<game::block_id> read(scale * scale * scale, game::block_id::EMPTY);
+    std::vector<game::block_id> write(read);
+    kernel::brownian_grow grow(gen, write, scale, 8, 20);
+    grow.generate(pool, read, write, 2000);
+
+    // Kill the pool
+    pool.kill();
+
+    return write;
+}
+
+bool test_brownian_grow()
+{
+    bool out = true;
+
+    // Growth must not depend on the number of threads
+    const std::vector<game::block_id> one = test_brownian_grow_generate(1);
+    const std::vector<game::block_id> two = test_brownian_grow_generate(2);
+    const std::vector<game::block_id> four = test_brownian_grow_generate(4);
+    out = out && one == two && one == four;
+
+    // Walkers must have stuck to the seeds
+    size_t count = 0;
+    for (const game::block_id id : one)
+    {
+        if (id != game::block_id::EMPTY)
+        {
+            count++;
+        }
+    }
+    out = out && count > 20;
+    if (!out)
+    {
+        throw std::runtime_error("Failed brownian grow determinism test");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
@@ -0,0 +1,162 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_CHUNK_CODEC__
+#define __TEST_CHUNK_CODEC__
+
+#include <game/chunk_codec.h>
+#include <game/id.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+const size_t test_chunk_codec_size = 8;
+
+std::vector<uint8_t> test_chunk_codec_encode(game::chunk_codec &codec, const std::vector<game::block_id> &chunk)
+{
+    // Function to get chunk rows
+    const size_t n = test_chunk_codec_size;
+    const auto row = [&chunk, n](const size_t r) -> const game::block_id * {
+        return &chunk[r * n];
+    };
+
+    // Encode the chunk
+    std::vector<uint8_t> out;
+    codec.encode(out, row, n * n, n);
+
+    return out;
+}
+
+bool test_chunk_codec_decode(const std::vector<uint8_t> &src, const size_t size, std::vector<game::block_id> &chunk)
+{
+    // Function to get chunk rows
+    const size_t n = test_chunk_codec_size;
+    const auto row = [&chunk, n](const size_t r) -> game::block_id * {
+        return &chunk[r * n];
+    };
+
+    // Decode the chunk on top of its current cells
+    return game::chunk_codec::decode(src.data(), size, row, n * n, n);
+}
+
+bool test_chunk_codec_round_trip(game::chunk_codec &codec, const std::vector<game::block_id> &chunk, const uint8_t mode)
+{
+    bool out = true;
+
+    // Encode the chunk with the expected mode
+    const std::vector<uint8_t> encoded = test_chunk_codec_encode(codec, chunk);
+    out = out && compare(mode, encoded[0]);
+
+    // Decode over a different chunk
+    std::vector<game::block_id> decoded(chunk.size(), game::block_id::SODIUM);
+    out = out && test_chunk_codec_decode(encoded, encoded.size(), decoded);
+    out = out && (decoded == chunk);
+
+    // Truncated input must fail
+    out = out && !test_chunk_codec_decode(encoded, encoded.size() - 1, decoded);
+
+    return out;
+}
+
+bool test_chunk_codec()
+{
+    bool out = true;
+
+    // Create a codec for 8x8x8 chunks
+    game::chunk_codec codec;
+    const size_t n = test_chunk_codec_size;
+    const size_t cells = n * n * n;
+
+    // Uniform chunk
+    std::vector<game::block_id> uniform(cells, game::block_id::STONE1);
+    out = out && test_chunk_codec_round_trip(codec, uniform, 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_codec uniform");
+    }
+
+    // Long runs of two blocks
+    std::vector<game::block_id> runs(cells, game::block_id::EMPTY);
+    std::fill(runs.begin(), runs.begin() + cells / 2, game::block_id::STONE1);
+    out = out && test_chunk_codec_round_trip(codec, runs, 1);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_codec run");
+    }
+
+    // Short runs of three blocks are packed
+    std::vector<game::block_id> packed(cells);
+    const game::block_id ids[3] = {game::block_id::EMPTY, game::block_id::STONE1, game::block_id::WOOD1};
+    for (size_t i = 0; i < cells; i++)
+    {
+        packed[i] = ids[i % 3];
+    }
+    out = out && test_chunk_codec_round_trip(codec, packed, 2);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_codec packed");
+    }
+
+    // An all INVALID delta keeps every cell
+    std::vector<game::block_id> delta(cells, game::block_id::INVALID);
+    std::vector<game::block_id> decoded = packed;
+    std::vector<uint8_t> encoded = test_chunk_codec_encode(codec, delta);
+    out = out && test_chunk_codec_decode(encoded, encoded.size(), decoded);
+    out = out && (decoded == packed);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_codec uniform delta");
+    }
+
+    // Run and packed deltas only write the valid cells
+    for (size_t step = 1; step <= 2; step++)
+    {
+        // A long run of changes, or a change in every other cell
+        std::vector<game::block_id> expect = packed;
+        std::fill(delta.begin(), delta.end(), game::block_id::INVALID);
+        for (size_t i = 0; i < cells; i++)
+        {
+            if ((step == 1 && i < cells / 4) || (step == 2 && i % 2 == 0))
+            {
+                delta[i] = expect[i] = game::block_id::SODIUM;
+            }
+        }
+
+        // Decode over a non-empty chunk
+        decoded = packed;
+        encoded = test_chunk_codec_encode(codec, delta);
+        out = out && compare(static_cast<int>(step), encoded[0]);
+        out = out && test_chunk_codec_decode(encoded, encoded.size(), decoded);
+        out = out && (decoded == expect);
+        if (!out)
+        {
+            throw std::runtime_error("Failed chunk_codec delta");
+        }
+    }
+
+    // Input too short for the header must fail
+    out = out && !test_chunk_codec_decode(encoded, 1, decoded);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_codec header");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
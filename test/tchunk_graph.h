@@ -0,0 +1,114 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_CHUNK_GRAPH__
+#define __TEST_CHUNK_GRAPH__
+
+#include <game/chunk_graph.h>
+#include <stdexcept>
+#include <test.h>
+
+bool test_chunk_graph()
+{
+    bool out = true;
+
+    // Create a solid grid of 3x3x3 chunks
+    const size_t scale = 24;
+    const size_t chunk_size = 8;
+    const size_t chunk_scale = scale / chunk_size;
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::STONE1);
+    const auto key = [scale](const size_t x, const size_t y, const size_t z) -> size_t {
+        return (x * scale * scale) + (y * scale) + z;
+    };
+
+    // Carve a straight tunnel along x through three chunks
+    for (size_t x = 1; x < 23; x++)
+    {
+        grid[key(x, 4, 4)] = game::block_id::EMPTY;
+    }
+
+    // Carve a longer detour through the chunks above
+    for (size_t y = 4; y <= 12; y++)
+    {
+        grid[key(4, y, 4)] = game::block_id::EMPTY;
+        grid[key(20, y, 4)] = game::block_id::EMPTY;
+    }
+    for (size_t x = 4; x <= 20; x++)
+    {
+        grid[key(x, 12, 4)] = game::block_id::EMPTY;
+    }
+
+    // Label and link every chunk
+    game::chunk_graph graph(scale, chunk_size);
+    const size_t chunks = chunk_scale * chunk_scale * chunk_scale;
+    for (size_t i = 0; i < chunks; i++)
+    {
+        graph.update(i, grid);
+    }
+
+    // The shortest route leaves the first chunk through the +x portal
+    const size_t start = key(2, 4, 4);
+    const size_t stop = key(22, 4, 4);
+    size_t portal = 0;
+    out = out && graph.next_portal(start, stop, portal);
+    out = out && (portal == key(8, 4, 4));
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_graph tunnel route");
+    }
+
+    // The next hop crosses into the last chunk
+    out = out && graph.next_portal(key(10, 4, 4), stop, portal);
+    out = out && (portal == key(16, 4, 4));
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_graph tunnel link");
+    }
+
+    // No portal inside one region or into solid cells
+    out = out && !graph.next_portal(start, key(4, 7, 4), portal);
+    out = out && !graph.next_portal(start, key(0, 0, 0), portal);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_graph same region");
+    }
+
+    // Block the tunnel in the middle chunk, route must take the detour
+    const size_t middle = chunk_scale * chunk_scale;
+    grid[key(12, 4, 4)] = game::block_id::STONE1;
+    graph.update(middle, grid);
+    out = out && graph.next_portal(start, stop, portal);
+    out = out && (portal == key(4, 8, 4));
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_graph detour route");
+    }
+
+    // Block the detour too, no route left
+    grid[key(4, 10, 4)] = game::block_id::STONE1;
+    graph.update(chunk_scale, grid);
+    out = out && !graph.next_portal(start, stop, portal);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk_graph blocked route");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
@@ -16,14 +16,30 @@ You should have received a copy of the GNU General Public License
 along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <iostream>
+#include <tastar.h>
+#include <tbrownian_grow.h>
+#include <tchunk_codec.h>
+#include <tchunk_graph.h>
+#include <tflow_field.h>
+#include <tmandelbulb.h>
+#include <tterrain_height.h>
 #include <tthread_pool.h>
+#include <tworld_file.h>
 
 int main()
 {
     try
     {
         bool out = true;
+        out = out && test_astar();
+        out = out && test_brownian_grow();
+        out = out && test_chunk_codec();
+        out = out && test_chunk_graph();
+        out = out && test_flow_field();
+        out = out && test_mandelbulb();
+        out = out && test_terrain_height();
         out = out && test_thread_pool();
+        out = out && test_world_file();
         if (out)
         {
             std::cout << "Game tests passed!" << std::endl;
@@ -0,0 +1,120 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_FLOW_FIELD__
+#define __TEST_FLOW_FIELD__
+
+#include <game/flow_field.h>
+#include <stdexcept>
+#include <test.h>
+
+size_t test_flow_field_dist(const size_t scale, const size_t a, const size_t b)
+{
+    // Manhattan distance between two grid keys
+    const size_t scale2 = scale * scale;
+    const size_t dx = std::max(a / scale2, b / scale2) - std::min(a / scale2, b / scale2);
+    const size_t ay = (a / scale) % scale;
+    const size_t by = (b / scale) % scale;
+    const size_t dy = std::max(ay, by) - std::min(ay, by);
+    const size_t dz = std::max(a % scale, b % scale) - std::min(a % scale, b % scale);
+    return dx + dy + dz;
+}
+
+bool test_flow_field()
+{
+    bool out = true;
+
+    // Create an empty grid
+    const size_t scale = 16;
+    const size_t scale2 = scale * scale;
+    std::vector<game::block_id> grid(scale2 * scale, game::block_id::EMPTY);
+
+    // Build the field around a target in the center
+    game::flow_field field(scale, scale);
+    std::vector<size_t> path;
+    const size_t start = 8 * scale + 8;
+    const size_t stop = 8 * scale2 + 8 * scale + 8;
+    field.update(grid, stop);
+
+    // Every step must follow the gradient one cell closer to the target
+    out = out && field.path(path, start, stop, 1000);
+    out = out && compare(9, path.size());
+    out = out && (path.back() == stop);
+    for (size_t i = 1; i < path.size() && out; i++)
+    {
+        out = out && compare(test_flow_field_dist(scale, path[i - 1], stop), test_flow_field_dist(scale, path[i], stop) + 1);
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow_field gradient");
+    }
+
+    // Field only answers for the current target
+    out = out && !field.path(path, start, stop + 1, 1000);
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow_field target");
+    }
+
+    // Build a wall at x = 4 with a single hole in the corner
+    for (size_t y = 0; y < scale; y++)
+    {
+        for (size_t z = 0; z < scale; z++)
+        {
+            if (y != scale - 1 || z != scale - 1)
+            {
+                grid[4 * scale2 + y * scale + z] = game::block_id::STONE1;
+            }
+        }
+    }
+
+    // Without invalidation the same target keeps the stale field
+    field.update(grid, stop);
+    out = out && field.path(path, start, stop, 1000);
+    out = out && compare(9, path.size());
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow_field cached");
+    }
+
+    // Invalidated field has no paths until it is rebuilt
+    field.invalidate();
+    out = out && !field.path(path, start, stop, 1000);
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow_field invalidate");
+    }
+
+    // Rebuilt field goes through the hole, 4 + 2 * 7 + 4 + 2 * 7 moves
+    field.update(grid, stop);
+    out = out && field.path(path, start, stop, 1000);
+    out = out && compare(37, path.size());
+    out = out && (path.back() == stop);
+    for (const size_t key : path)
+    {
+        out = out && (grid[key] == game::block_id::EMPTY);
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow_field rebuild");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_MANDELBULB__
+#define __TEST_MANDELBULB__
+
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <kernel/mandelbulb_asym.h>
+#include <kernel/mandelbulb_sym.h>
+#include <min/vec3.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+template <typename M>
+bool test_mandelbulb_kernel(game::thread_pool &pool, M &m)
+{
+    // Cell centers of a small grid
+    const size_t size = 32;
+    const auto f = [size](const size_t i) {
+        const float x = static_cast<float>(i / (size * size)) - size / 2.0 + 0.5;
+        const float y = static_cast<float>((i / size) % size) - size / 2.0 + 0.5;
+        const float z = static_cast<float>(i % size) - size / 2.0 + 0.5;
+        return min::vec3<float>(x, y, z);
+    };
+
+    // Generate with the scalar and SIMD kernels
+    std::vector<game::block_id> scalar(size * size * size, game::block_id::EMPTY);
+    std::vector<game::block_id> simd(scalar);
+    m.generate_scalar(pool, scalar, size, f);
+    m.generate(pool, simd, size, f);
+
+    // Both kernels must produce the same grid
+    for (size_t i = 0; i < scalar.size(); i++)
+    {
+        if (scalar[i] != simd[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename M>
+bool test_mandelbulb_adaptive(game::thread_pool &pool, M &m)
+{
+    // Cell centers of a small grid
+    const size_t size = 36;
+    const auto f = [size](const size_t i) {
+        const float x = static_cast<float>(i / (size * size)) - size / 2.0 + 0.5;
+        const float y = static_cast<float>((i / size) % size) - size / 2.0 + 0.5;
+        const float z = static_cast<float>(i % size) - size / 2.0 + 0.5;
+        return min::vec3<float>(x, y, z);
+    };
+
+    // Generate exhaustively and adaptively
+    std::vector<game::block_id> full(size * size * size, game::block_id::EMPTY);
+    std::vector<game::block_id> adaptive(full);
+    std::vector<game::block_id> verified(full);
+    m.generate(pool, full, size, f);
+    const size_t chunk = 12;
+    m.generate_adaptive(pool, adaptive, size, chunk, f, false);
+    m.generate_adaptive(pool, verified, size, chunk, f, true);
+
+    // Chunks sample the same blocks as the whole grid, even if they are not a multiple of the block size
+    std::vector<game::block_id> chunked(full);
+    for (size_t x = 0; x < size; x += chunk)
+    {
+        for (size_t y = 0; y < size; y += chunk)
+        {
+            for (size_t z = 0; z < size; z += chunk)
+            {
+                m.generate_chunk(chunked, size, f, x, y, z, chunk);
+            }
+        }
+    }
+    if (chunked != adaptive)
+    {
+        return false;
+    }
+
+    // Adaptive sampling may miss thin features, verify mode must be exact
+    size_t missed = 0;
+    for (size_t i = 0; i < full.size(); i++)
+    {
+        if (full[i] != verified[i])
+        {
+            return false;
+        }
+        if (full[i] != adaptive[i])
+        {
+            missed++;
+        }
+    }
+
+    return missed * 100 < full.size();
+}
+
+bool test_mandelbulb()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel
+    game::thread_pool pool;
+
+    // Test symmetrical kernel
+    kernel::mandelbulb_sym sym(29, 446, 426, 106);
+    out = out && test_mandelbulb_kernel(pool, sym);
+    if (!out)
+    {
+        throw std::runtime_error("Failed symmetrical mandelbulb simd test");
+    }
+
+    // Test asymmetrical kernel
+    kernel::mandelbulb_asym asym(236, 251, 126, 23, 157, 102, 197, 91, 133, 125, 76, 254);
+    out = out && test_mandelbulb_kernel(pool, asym);
+    if (!out)
+    {
+        throw std::runtime_error("Failed asymmetrical mandelbulb simd test");
+    }
+
+    // Test adaptive sampling
+    out = out && test_mandelbulb_adaptive(pool, asym);
+    if (!out)
+    {
+        throw std::runtime_error("Failed adaptive mandelbulb test");
+    }
+
+    // Kill the pool
+    pool.kill();
+
+    // return status
+    return out;
+}
+
+#endif
@@ -0,0 +1,92 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_TERRAIN_HEIGHT__
+#define __TEST_TERRAIN_HEIGHT__
+
+#include <algorithm>
+#include <game/id.h>
+#include <game/thread_pool.h>
+#include <kernel/terrain_height.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+void test_terrain_height_generate(const kernel::terrain_height &h, std::vector<game::block_id> &grid, const size_t scale, const size_t chunk, const bool reverse)
+{
+    // Generate every chunk, in either order
+    const size_t chunks = scale / chunk;
+    const size_t count = chunks * chunks * chunks;
+    for (size_t i = 0; i < count; i++)
+    {
+        const size_t c = (reverse) ? count - 1 - i : i;
+        const size_t x = (c / (chunks * chunks)) * chunk;
+        const size_t y = ((c / chunks) % chunks) * chunk;
+        const size_t z = (c % chunks) * chunk;
+        h.generate_terrain(grid, x, y, z);
+        h.generate_trees(grid, x, y, z);
+        h.generate_plants(grid, x, y, z);
+    }
+}
+
+bool test_terrain_height()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel
+    game::thread_pool pool;
+
+    // Tree count stays near the requested 250 to 1000 trees
+    const size_t scale = 128;
+    const size_t chunk = 16;
+    for (uint32_t seed = 1; seed <= 16; seed++)
+    {
+        const kernel::terrain_height h(pool, scale, chunk, scale / 2, scale - 1, seed);
+        const size_t trees = h.get_tree_count();
+        out = out && trees >= 200 && trees <= 1050;
+    }
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain height tree count test");
+    }
+
+    // Same seed places the same trees in any chunk order
+    const kernel::terrain_height one(pool, scale, chunk, scale / 2, scale - 1, 1234);
+    const kernel::terrain_height two(pool, scale, chunk, scale / 2, scale - 1, 1234);
+    out = out && one.get_tree_count() == two.get_tree_count();
+    out = out && one.get_plant_count() == two.get_plant_count();
+    std::vector<game::block_id> forward(scale * scale * scale, game::block_id::EMPTY);
+    std::vector<game::block_id> backward(forward);
+    test_terrain_height_generate(one, forward, scale, chunk, false);
+    test_terrain_height_generate(two, backward, scale, chunk, true);
+    out = out && forward == backward;
+
+    // Trees were actually placed
+    out = out && std::count(forward.begin(), forward.end(), game::block_id::WOOD1) + std::count(forward.begin(), forward.end(), game::block_id::WOOD2) > 0;
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain height determinism test");
+    }
+
+    // Kill the pool
+    pool.kill();
+
+    // return status
+    return out;
+}
+
+#endif
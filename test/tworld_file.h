@@ -0,0 +1,155 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef __TEST_WORLD_FILE__
+#define __TEST_WORLD_FILE__
+
+#include <cstdio>
+#include <game/chunk_baseline.h>
+#include <game/file.h>
+#include <game/save_queue.h>
+#include <game/world_file.h>
+#include <game/world_seed.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_world_file_load(const std::string &file_name, std::vector<game::block_id> &grid, const std::vector<game::block_id> &world,
+                          const std::vector<uint32_t> &gen, const game::world_seed &seed)
+{
+    // Apply the saved chunks on top of the generated world
+    game::world_file file(file_name, 32, 8);
+    grid = world;
+    const bool out = file.open(gen, seed);
+    for (size_t i = 0; out && i < gen.size(); i++)
+    {
+        file.load_chunk(grid, i);
+    }
+    file.close();
+
+    return out;
+}
+
+bool test_world_file()
+{
+    bool out = true;
+
+    // Generate a world of 4x4x4 chunks, lower half is stone
+    const size_t scale = 32;
+    const size_t chunk_size = 8;
+    const size_t chunks = 64;
+    std::vector<game::block_id> world(scale * scale * scale, game::block_id::EMPTY);
+    for (size_t i = 0; i < world.size(); i++)
+    {
+        if ((i / scale) % scale < scale / 2)
+        {
+            world[i] = game::block_id::STONE1;
+        }
+    }
+    game::chunk_baseline base(scale, chunk_size);
+    base.encode(world);
+
+    // Start from a clean file
+    const std::string file_name = "tworld_file.save";
+    const game::world_seed seed(42, false);
+    std::remove(file_name.c_str());
+
+    // Edit a cell in the first chunk and write the snapshot
+    std::vector<game::block_id> grid = world;
+    std::vector<uint32_t> gen(chunks, 0);
+    std::vector<bool> paged(chunks, true);
+    game::world_file file(file_name, scale, chunk_size);
+    file.open(gen, seed);
+    grid[0] = game::block_id::WOOD1;
+    gen[0]++;
+    file.save(grid, base, gen, seed, paged);
+
+    // Edit a cell in the second chunk and append it to the log
+    grid[8] = game::block_id::WOOD1;
+    gen[1]++;
+    file.save(grid, base, gen, seed, paged);
+    game::save_queue::writer.wait();
+
+    // Tear the last record
+    std::vector<uint8_t> stream;
+    game::load_file(file_name, stream);
+    stream.resize(stream.size() - 2);
+    game::save_file(file_name, stream);
+
+    // The torn record is dropped, the snapshot survives
+    out = out && test_world_file_load(file_name, grid, world, gen, seed);
+    out = out && (grid[0] == game::block_id::WOOD1);
+    out = out && (grid[8] == world[8]);
+    if (!out)
+    {
+        throw std::runtime_error("Failed world_file torn record");
+    }
+
+    // Save an edit after opening the torn file, the first chunk isn't generated yet and is only a fence
+    game::world_file torn(file_name, scale, chunk_size);
+    out = out && torn.open(gen, seed);
+    std::vector<game::block_id> fence = grid;
+    fence[0] = game::block_id::STONE2;
+    fence[16] = grid[16] = game::block_id::WOOD1;
+    gen[2]++;
+    paged[0] = false;
+    torn.save(fence, base, gen, seed, paged);
+    game::save_queue::writer.wait();
+
+    // Records written after the torn one must not be lost
+    std::vector<game::block_id> loaded;
+    out = out && test_world_file_load(file_name, loaded, world, gen, seed);
+    out = out && (loaded == grid);
+    if (!out)
+    {
+        throw std::runtime_error("Failed world_file append after torn record");
+    }
+
+    // Edit enough chunks to compact the file again without paging, the released file is mapped again for the ungenerated chunk
+    for (size_t i = 3; i < chunks; i++)
+    {
+        const size_t origin = game::chunk_baseline::chunk_origin(scale, chunk_size, i);
+        for (size_t x = 0; x < chunk_size; x++)
+        {
+            for (size_t y = 0; y < chunk_size; y++)
+            {
+                for (size_t z = 0; z < chunk_size; z++)
+                {
+                    const size_t key = origin + (x * scale + y) * scale + z;
+                    fence[key] = grid[key] = ((x + y + z) % 2 == 0) ? game::block_id::WOOD1 : game::block_id::SODIUM;
+                }
+            }
+        }
+        gen[i]++;
+    }
+    torn.save(fence, base, gen, seed, paged);
+    game::save_queue::writer.wait();
+    out = out && test_world_file_load(file_name, loaded, world, gen, seed);
+    out = out && (loaded == grid);
+    if (!out)
+    {
+        throw std::runtime_error("Failed world_file ungenerated chunk");
+    }
+
+    // Clean up
+    std::remove(file_name.c_str());
+
+    // return status
+    return out;
+}
+
+#endif